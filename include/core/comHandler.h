@@ -21,12 +21,39 @@ typedef struct {
 	const char *(*funcPointer)(char **args, int numArgs);
 } functionDef;
 
+/**
+ * Most commands that can be registered
+ */
+#define MAX_COMMANDS 256
+
+/**
+ * Perfect hash sizes. Slots must be a power of two; twice the commands keeps the search
+ * for displacements short.
+ */
+#define COMMAND_SLOTS 512
+#define COMMAND_BUCKETS 128
+#define COMMAND_MAX_DISPLACE 65536
+
+/**
+ * Nodes in the prefix trie of command names, one per distinct prefix
+ */
+#define COMMAND_TRIE_NODES 2048
+
+typedef struct {
+	char c; //last character of the prefix
+	short child; //first longer prefix, -1 if none
+	short sibling; //next prefix of the same length and parent, -1 if none
+	short command; //index of the functionDef named by the prefix, -1 if none
+	short count; //number of names starting with the prefix
+} commandNode;
+
 /*******************************
  * FunctionDef Handling
  *******************************/
 /**
  * Adds function definition struct, created from provided params to the functionDefs array
- * This allows the function to be called in the command handler by its name
+ * This allows the function to be called in the command handler by its name. The name is
+ * added to the perfect hash and the prefix trie.
  *
  * @param name - string representation of the function
  * @param helpString - const string to be displayed for help
@@ -35,21 +62,39 @@ typedef struct {
 void addFunctionDef(char *name, const char *helpString, const char *(funcPointer)(char **args, int numArgs));
 
 /**
- * Gets the functionDef struct corresponding to the name provided, returns a functionDef with null
- * funcPointer if none are found
+ * Gets the functionDef struct corresponding to the name provided. The name is found through
+ * the perfect hash; if it is not a full name, it may be an abbreviation that only one command
+ * starts with.
  *
- * @param name - name of the functionDef
- * @return functionDef
+ * @param name - name of the functionDef, or a unique start of one
+ * @return functionDef * in the table, or NULL if none is found
  */
-functionDef getFunctionDef(char *name);
+functionDef *getFunctionDef(char *name);
 
 /**
  * Gets the help string from the struct for the function name provided
  *
- * @param name - name associated witht he struct from which to get the help string
+ * @param name - name associated witht he struct from which to get the help string, or a unique start of one
  * @return const char* help string
  */
 const char *getHelpString(char *name);
+
+/**
+ * Finds how far a partly typed command name can be completed
+ *
+ * @param prefix - the start of a name
+ * @param rest - set to the characters every matching name has after prefix
+ * @param size - size of rest
+ * @return the number of names starting with prefix
+ */
+int completeCommand(const char *prefix, char *rest, int size);
+
+/**
+ * Prints every command name starting with a prefix, on one line
+ *
+ * @param prefix - the start of a name
+ */
+void printCompletions(const char *prefix);
 /*******************************
  * Handle Com History
  *******************************/
@@ -78,20 +123,21 @@ void addComHistory(char *newCom);
 void printStart();
 
 /**
- * Helper function to move the insertion point from the end of the line to the correct placement
+ * Helper function to send the echo for one keystroke. The output is formatted with
+ * kvsnprintf and handed to the serial driver in a single write.
  *
- * @param endIndex - index of last char printed
- * @param insertionIndex - index of where insertion point should be
+ * @param fmt - format of the output, as for ksnprintf
  */
-void returnToInsertionPoint(int endIndex, int insertionIndex);
+void editorWrite(const char *fmt, ...);
 
 /**
- * Helper function to remove all printed chars on the current line of input back to the >>
+ * Helper function to replace the text on the current line of input after the >>.
+ * Moves back to the start of the input, erases to the end of the line and prints the new text.
  *
- * @param endIndex - index of last char printed
- * @param insertionIndex - index of where insertion point should be
+ * @param insertionIndex - index of where the insertion point is
+ * @param newText - the text to show
  */
-void eraseCurrentRow(int endIndex, int insertionIndex);
+void replaceCurrentRow(int insertionIndex, const char *newText);
 
 /*******************************
  * Handle Input
@@ -64,4 +64,88 @@ const char *shutdown(char **args, int numArgs);
  */
 const char *date(char **args, int numArgs);
 
+/**
+ * Prints the serial device table, or changes the line speed of a port. After a switch a
+ * test pattern is written to the port and the measured throughput is printed.
+ *
+ * Usage: serial [--port n] [--baud n]
+ *
+ * Args:
+ * 	[no args] - Prints every port, its IRQ and line speed
+ * 	--port - The port to change, COMn; COM1 if not given
+ * 	--baud - Switches the port to speed n and prints the measured throughput
+ *
+ * @param args The arguments to pass to the function
+ * @param numArgs The number of arguments
+ * @return The result message
+ */
+const char *serial(char **args, int numArgs);
+
+/**
+ * Replays the kernel log, or changes what each subsystem logs.
+ *
+ * Usage: dmesg [--level lvl] [--sub name] [--filter name lvl] [--filters] [--port n]
+ *
+ * Args:
+ * 	[no args] - Prints every record still in the log
+ * 	--level - Only prints records at level lvl or more severe
+ * 	--sub - Only prints records from subsystem name
+ * 	--filter - Makes subsystem name log only level lvl or more severe
+ * 	--filters - Prints each subsystem's level and the overrun count
+ * 	--port - Sends new records to COMn or virtio as they are logged, or to the console for 0
+ *
+ * @param args The arguments to pass to the function
+ * @param numArgs The number of arguments
+ * @return The result message
+ */
+const char *dmesg(char **args, int numArgs);
+
+/**
+ * Chooses where console output goes: the serial port, the VGA screen, or both.
+ * Input always comes from the serial port.
+ *
+ * Usage: console [--serial] [--vga] [--both]
+ *
+ * Args:
+ * 	[no args] - Prints where output goes
+ * 	--serial - Writes output to COM1 only
+ * 	--vga - Writes output to the screen only
+ * 	--both - Writes output to COM1 and the screen
+ *
+ * @param args The arguments to pass to the function
+ * @param numArgs The number of arguments
+ * @return The result message
+ */
+const char *console(char **args, int numArgs);
+
+/**
+ * Lists the PCI functions found at boot and whether the virtio console
+ * is carrying output.
+ *
+ * Usage: pci
+ *
+ * @param args The arguments to pass to the function
+ * @param numArgs The number of arguments
+ * @return The result message
+ */
+const char *pci(char **args, int numArgs);
+
+/**
+ * Controls the binary event trace: which port carries it and which
+ * classes of events are sent. tools/ktracedump decodes the stream.
+ *
+ * Usage: ktrace [--port n] [--on classes] [--off]
+ *
+ * Args:
+ * 	[no args] - Prints the port, the classes traced, bytes sent and events lost
+ * 	--port - Sends the trace to COMn or virtio; not the console port
+ * 	--on - Traces the classes, a comma separated list of sched, heap, irq or all
+ * 	--off - Stops tracing
+ *
+ * @param args The arguments to pass to the function
+ * @param numArgs The number of arguments
+ * @return The result message
+ */
+const char *ktrace(char **args, int numArgs);
+
 #endif
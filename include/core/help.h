@@ -19,7 +19,10 @@
     "\n"\
     "Args:\n"\
     "    [no args] - Returns the help for the help command\n"\
-    "    commandName - The name of the command to get help for")
+    "    commandName - The name of the command to get help for\n"\
+    "\n"\
+    "Any command can be typed as a start of its name that no other command shares,\n"\
+    "and Tab completes a partly typed command name.")
 
 
 #define HELP_COMMAND_SHUTDOWN ((const char*) \
@@ -44,4 +47,65 @@
     "    --setdate - Sets the date to the specified date (returns the new date/time)\n"\
     "    --settime - Sets the time to the specified time (returns the new date/time)")
 
+#define HELP_COMMAND_SERIAL ((const char*) \
+    "Prints the serial device table, or changes the line speed of a port.\n"\
+    "Speeds must divide 115200, which is also the fastest.\n"\
+    "\n"\
+    "Usage: serial [--port n] [--baud n]\n"\
+    "\n"\
+    "Args:\n"\
+    "    [no args] - Prints every port, its IRQ and line speed\n"\
+    "    --port - The port to change, COMn; COM1 if not given\n"\
+    "    --baud - Switches the port to speed n and prints the measured throughput")
+
+#define HELP_COMMAND_DMESG ((const char*) \
+    "Replays the kernel log, or changes what each subsystem logs.\n"\
+    "Levels are err, warn, info and debug; subsystems are core, mem, serial and proc.\n"\
+    "\n"\
+    "Usage: dmesg [--level lvl] [--sub name] [--filter name lvl] [--filters] [--port n]\n"\
+    "\n"\
+    "Args:\n"\
+    "    [no args] - Prints every record still in the log\n"\
+    "    --level - Only prints records at level lvl or more severe\n"\
+    "    --sub - Only prints records from subsystem name\n"\
+    "    --filter - Makes subsystem name log only level lvl or more severe\n"\
+    "    --filters - Prints each subsystem's level and the overrun count\n"\
+    "    --port - Sends new records to COMn or virtio as they are logged, or to the console for 0;\n"\
+    "             not the port carrying the event trace")
+
+#define HELP_COMMAND_CONSOLE ((const char*) \
+    "Chooses where console output goes: the serial port, the VGA screen, or both.\n"\
+    "Input always comes from the serial port. console=vga or console=both on the\n"\
+    "boot command line picks the same at boot.\n"\
+    "\n"\
+    "Usage: console [--serial] [--vga] [--both]\n"\
+    "\n"\
+    "Args:\n"\
+    "    [no args] - Prints where output goes\n"\
+    "    --serial - Writes output to COM1 only\n"\
+    "    --vga - Writes output to the screen only\n"\
+    "    --both - Writes output to COM1 and the screen")
+
+#define HELP_COMMAND_PCI ((const char*) \
+    "Lists the PCI functions found at boot: bus:slot.function, vendor:device,\n"\
+    "class, IRQ line and I/O ranges. Also prints how much has been sent through\n"\
+    "the virtio console, if there is one.\n"\
+    "\n"\
+    "Usage: pci")
+
+#define HELP_COMMAND_KTRACE ((const char*) \
+    "Controls the binary event trace: which port carries it and which classes of\n"\
+    "events are sent. Frames are buffered and sent by the idle process; decode a\n"\
+    "capture with tools/ktracedump. ktrace=n on the boot command line traces\n"\
+    "everything to port n from boot.\n"\
+    "\n"\
+    "Usage: ktrace [--port n] [--on classes] [--off]\n"\
+    "\n"\
+    "Args:\n"\
+    "    [no args] - Prints the port, the classes traced, bytes sent and events lost\n"\
+    "    --port - Sends the trace to COMn or virtio; not a port carrying the\n"\
+    "             console, log or heap trace\n"\
+    "    --on - Traces the classes, a comma separated list of sched, heap, irq or all\n"\
+    "    --off - Stops tracing")
+
 #endif
@@ -2,8 +2,13 @@
 #define _INTERRUPTS_H
 
 /**
- * Installs the initial interrupt handlers for the first 32
- * irq lines. Most do a panic for now.
+ * Vector IRQ 0 is remapped to by init_pic; IRQ n arrives at this plus n.
+ */
+#define PIC_VECTOR_BASE 0x20
+
+/**
+ * Installs the initial interrupt handlers for the first 32 irq lines,
+ * most of which panic for now, and a default handler on every PIC vector.
  */
 void init_irq(void);
 
@@ -13,4 +18,27 @@ void init_irq(void);
  */
 void init_pic(void);
 
+/**
+ * Lets an IRQ line through the PIC.
+ *
+ * @param irq The IRQ line, 0-15
+ */
+void pic_unmask(int irq);
+
+/**
+ * Acknowledges an IRQ so the PIC delivers the next one.
+ *
+ * @param irq The IRQ line, 0-15
+ */
+void pic_eoi(int irq);
+
+/**
+ * Default handler for an IRQ no driver has claimed. A spurious IRQ7 or
+ * IRQ15 is not acknowledged, apart from the master's EOI for the cascade
+ * line in the IRQ15 case. Anything else is acknowledged and dropped.
+ *
+ * @param irq The IRQ line, 0-15
+ */
+void do_pic_irq(int irq);
+
 #endif
@@ -22,4 +22,46 @@
       r;                                                    \
     })
 
+/**
+ * Writes a word of data to a port.
+ *
+ * @param port The port to write the data to
+ * @param data The word to write
+ */
+#define outw(port, data)                                    \
+  asm volatile ("outw %%ax,%%dx" : : "a" (data), "d" (port))
+
+/**
+ * Reads a word of data from a port.
+ *
+ * @param port The port to read the data from
+ * @return The word from the port
+ */
+#define inw(port) ({                                        \
+      unsigned short r;                                     \
+      asm volatile ("inw %%dx,%%ax": "=a" (r): "d" (port)); \
+      r;                                                    \
+    })
+
+/**
+ * Writes a double word of data to a port.
+ *
+ * @param port The port to write the data to
+ * @param data The double word to write
+ */
+#define outl(port, data)                                     \
+  asm volatile ("outl %%eax,%%dx" : : "a" (data), "d" (port))
+
+/**
+ * Reads a double word of data from a port.
+ *
+ * @param port The port to read the data from
+ * @return The double word from the port
+ */
+#define inl(port) ({                                         \
+      unsigned int r;                                        \
+      asm volatile ("inl %%dx,%%eax": "=a" (r): "d" (port)); \
+      r;                                                     \
+    })
+
 #endif
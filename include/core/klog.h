@@ -0,0 +1,137 @@
+#ifndef _KLOG_H
+#define _KLOG_H
+
+#include <system.h>
+
+/**
+ * Severity levels, most severe first. A subsystem filter keeps every
+ * message at or above its level.
+ */
+#define KLOG_ERR   0
+#define KLOG_WARN  1
+#define KLOG_INFO  2
+#define KLOG_DEBUG 3
+#define KLOG_LEVELS 4
+
+/**
+ * Subsystems a message can come from.
+ */
+#define KLOG_CORE   0
+#define KLOG_MEM    1
+#define KLOG_SERIAL 2
+#define KLOG_PROC   3
+#define KLOG_SUBSYSTEMS 4
+
+/**
+ * Number of records kept; a power of two so the sequence can wrap.
+ */
+#define KLOG_RECORDS 128
+
+/**
+ * Longest message stored, including the terminator. Longer ones are cut.
+ */
+#define KLOG_MSG_SIZE 96
+
+/**
+ * Marks a record a producer is still writing.
+ */
+#define KLOG_BUSY 0xFFFFFFFF
+
+/**
+ * One log record. seq is one more than the record's sequence number once
+ * the record is complete, so a reader can tell a finished record from one
+ * being written or one already overwritten by a later message.
+ */
+typedef struct {
+	volatile u32int seq;
+	u8int level;
+	u8int subsystem;
+	char msg[KLOG_MSG_SIZE];
+} klog_record;
+
+/**
+ * Logs a message. Never blocks: the message is copied into the ring and
+ * printed later by klog_drain. If the oldest record has not been printed
+ * yet it is overwritten and counted as an overrun.
+ *
+ * @param subsystem The KLOG_* subsystem
+ * @param level The KLOG_* level
+ * @param msg The message
+ */
+void klog(int subsystem, int level, const char *msg);
+
+/**
+ * Prints every record logged since the last drain to the active serial
+ * device. Does nothing if a drain is already running.
+ */
+void klog_drain();
+
+/**
+ * Tests if there are records the drain has not printed yet.
+ *
+ * @return True if there is something to drain
+ */
+int klog_pending();
+
+/**
+ * Sends the drained log to its own device instead of the console.
+ *
+ * @param device The device, or 0 for the console
+ */
+void klog_set_device(int device);
+
+/**
+ * Gets the device the drained log is sent to.
+ *
+ * @return The device, or 0 for the console
+ */
+int klog_get_device();
+
+/**
+ * Sets the least severe level stored for a subsystem.
+ *
+ * @param subsystem The KLOG_* subsystem
+ * @param level The KLOG_* level
+ */
+void klog_set_filter(int subsystem, int level);
+
+/**
+ * Gets the least severe level stored for a subsystem.
+ *
+ * @param subsystem The KLOG_* subsystem
+ * @return The KLOG_* level
+ */
+int klog_get_filter(int subsystem);
+
+/**
+ * Prints the records still in the ring, oldest first.
+ *
+ * @param level Only records at or above this level are printed
+ * @param subsystem Only records from this subsystem are printed, or -1 for all
+ */
+void klog_replay(int level, int subsystem);
+
+/**
+ * Gets the number of records overwritten before they were printed.
+ *
+ * @return The number of overruns
+ */
+u32int klog_overruns();
+
+/**
+ * Gets the name of a level.
+ *
+ * @param level The KLOG_* level
+ * @return The name, or NULL if there is no such level
+ */
+const char *klog_level_name(int level);
+
+/**
+ * Gets the name of a subsystem.
+ *
+ * @param subsystem The KLOG_* subsystem
+ * @return The name, or NULL if there is no such subsystem
+ */
+const char *klog_subsystem_name(int subsystem);
+
+#endif
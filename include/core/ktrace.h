@@ -0,0 +1,164 @@
+#ifndef _KTRACE_H
+#define _KTRACE_H
+
+#include <system.h>
+
+/**
+ * Binary event trace. Each event is one frame, little-endian:
+ *
+ *	offset	size	field
+ *	0	1	KTRACE_SYNC
+ *	1	1	type, a KTRACE_EV_* value
+ *	2	1	payload length n
+ *	3	8	time stamp counter
+ *	11	n	payload
+ *	11+n	2	CRC-16/CCITT (poly 0x1021, init 0xFFFF) of bytes 1 to 10+n
+ *
+ * tools/ktracedump turns a captured stream into CSV or JSON.
+ */
+#define KTRACE_SYNC        0xA5
+#define KTRACE_HEADER      11
+#define KTRACE_MAX_PAYLOAD 16
+#define KTRACE_MAX_FRAME   (KTRACE_HEADER + KTRACE_MAX_PAYLOAD + 2)
+
+/**
+ * Event types and their payloads.
+ */
+#define KTRACE_EV_CLOCK 1 //u32 cycles per millisecond; sent when tracing starts
+#define KTRACE_EV_SCHED 2 //i32 pid switched from, i32 pid switched to (-1 for the kernel), u8 op code
+#define KTRACE_EV_ALLOC 3 //u32 block address, u32 size
+#define KTRACE_EV_FREE  4 //u32 block address
+#define KTRACE_EV_IRQ   5 //u8 irq line
+#define KTRACE_EV_LOST  6 //u32 events dropped because the buffer was full
+
+/**
+ * Event classes, for ktrace_set_mask.
+ */
+#define KTRACE_SCHED 0x1
+#define KTRACE_HEAP  0x2
+#define KTRACE_IRQ   0x4
+#define KTRACE_ALL   (KTRACE_SCHED | KTRACE_HEAP | KTRACE_IRQ)
+
+/**
+ * Bytes of frames held until the idle process sends them. A power of two.
+ */
+#define KTRACE_BUFFER 4096
+
+/**
+ * Classes being traced; 0 while tracing is off.
+ */
+extern u32int ktraceMask;
+
+/**
+ * Tests if a class of events is being traced. Cheap enough to call on
+ * every event.
+ *
+ * @param cls The KTRACE_* class
+ * @return True if it is being traced
+ */
+static inline int ktrace_on(u32int cls) {
+	return ktraceMask & cls;
+}
+
+/**
+ * Chooses the device frames are sent to. Tracing stops while there is none.
+ *
+ * @param device The device; a serial port or VIRTIO_CON, 0 for none
+ */
+void ktrace_set_device(int device);
+
+/**
+ * Gets the device frames are sent to.
+ *
+ * @return The device, or 0 for none
+ */
+int ktrace_get_device();
+
+/**
+ * Tests if a device can carry the trace by itself. Frames are binary, so
+ * the port must not also take the console, the kernel log or the heap
+ * trace.
+ *
+ * @param dev The device
+ * @return True if it is a port nothing else writes to
+ */
+int ktrace_port_ok(int dev);
+
+/**
+ * Chooses which classes of events are traced. Turning tracing on sends a
+ * clock frame first, so the decoder can turn cycles into time.
+ *
+ * @param mask KTRACE_* classes, 0 to stop
+ */
+void ktrace_set_mask(u32int mask);
+
+/**
+ * Adds a frame to the buffer. Safe from an interrupt handler. If there is
+ * no room the event is counted as lost and reported by a later frame.
+ *
+ * @param type The KTRACE_EV_* type
+ * @param payload The payload
+ * @param len The payload length, at most KTRACE_MAX_PAYLOAD
+ */
+void ktrace_event(int type, const void *payload, int len);
+
+/**
+ * Records a switch between processes.
+ *
+ * @param from The pid switched from, -1 for the kernel
+ * @param to The pid switched to, -1 for the kernel
+ * @param op The system call op code that caused it
+ */
+void ktrace_sched(int from, int to, int op);
+
+/**
+ * Records a heap allocation.
+ *
+ * @param addr The block address
+ * @param size The size
+ */
+void ktrace_alloc(u32int addr, u32int size);
+
+/**
+ * Records a heap free.
+ *
+ * @param addr The block address
+ */
+void ktrace_free(u32int addr);
+
+/**
+ * Records an interrupt. Interrupts on the trace port's own line are not
+ * recorded, since sending the frames would cause more of them.
+ *
+ * @param irq The irq line
+ */
+void ktrace_irq(int irq);
+
+/**
+ * Sends the buffered frames to the trace device. Does nothing if a drain
+ * is already running.
+ */
+void ktrace_drain();
+
+/**
+ * Tests if there are frames waiting to be sent.
+ *
+ * @return True if there is something to drain
+ */
+int ktrace_pending();
+
+/**
+ * Gets the number of bytes of frames sent.
+ *
+ * @return The number of bytes
+ */
+u32int ktrace_sent();
+
+/**
+ * Gets the number of events dropped because the buffer was full.
+ *
+ * @return The number of events
+ */
+u32int ktrace_lost();
+
+#endif
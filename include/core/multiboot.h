@@ -0,0 +1,56 @@
+#ifndef _MULTIBOOT_H
+#define _MULTIBOOT_H
+
+#include "system.h"
+
+/**
+ * Value left in eax by a multiboot-compliant boot loader.
+ */
+#define MULTIBOOT_BOOT_MAGIC 0x2BADB002
+
+/**
+ * Multiboot info flags.
+ */
+#define MULTIBOOT_FLAG_MEM     0x001 //mem_lower and mem_upper are valid
+#define MULTIBOOT_FLAG_CMDLINE 0x004 //cmdline is valid
+#define MULTIBOOT_FLAG_MMAP    0x040 //mmap_length and mmap_addr are valid
+
+/**
+ * Memory map region types.
+ */
+#define MMAP_AVAILABLE 1
+#define MMAP_RESERVED  2
+#define MMAP_ACPI      3
+#define MMAP_NVS       4
+
+/**
+ * Multiboot information structure, as far as the memory fields.
+ */
+typedef struct multiboot_info_struct {
+	u32int flags;
+	u32int mem_lower;   //KB below 1MB
+	u32int mem_upper;   //KB above 1MB
+	u32int boot_device;
+	u32int cmdline;
+	u32int mods_count;
+	u32int mods_addr;
+	u32int syms[4];
+	u32int mmap_length; //bytes of memory map
+	u32int mmap_addr;   //address of the first entry
+}
+	__attribute__ ((packed)) multiboot_info;
+
+/**
+ * Memory map entry. size does not count the size field itself.
+ */
+typedef struct mmap_entry_struct {
+	u32int size;
+	u32int base_low;
+	u32int base_high;
+	u32int length_low;
+	u32int length_high;
+	u32int type;
+}
+	__attribute__ ((packed)) mmap_entry;
+
+#endif
@@ -19,8 +19,19 @@
 #define SYSTEM 0
 #define APPLICATION 1
 
+/**
+ * Heap usage of a process, kept up to date by the heap on every allocation and free
+ */
+typedef struct memAccount {
+	int bytes; //bytes in blocks owned by the process, including structs
+	int blocks; //number of blocks owned by the process
+	int quota; //most bytes the process may own, 0 for no limit
+	struct cmcb *blockList; //blocks owned by the process
+} memAccount;
+
 typedef struct pcb {
 	char *processName;
+	int pid;
 	int processClass;
 	int priority;
 
@@ -29,6 +40,8 @@ typedef struct pcb {
 	//stack area, min 1024bytes
 	unsigned char* stackTop;
 	unsigned char* stackBottom;
+
+	memAccount mem;
 } pcb;
 
 /**
@@ -39,7 +52,8 @@ typedef struct pcb {
 pcb *allocatePCB();
 
 /**
- * Frees memory that is allocated for the pcb provided
+ * Frees memory that is allocated for the pcb provided. The stack is
+ * left alone if stackBottom was cleared, for a process still running on it.
  *
  * @param pcbPtr pointer to pcb to be freed
  * @return integer code - 1 if successful, -1 otherwise
@@ -0,0 +1,121 @@
+#ifndef _PCI_H
+#define _PCI_H
+
+#include <system.h>
+
+/**
+ * Configuration mechanism #1 ports.
+ */
+#define PCI_CONFIG_ADDRESS 0xCF8
+#define PCI_CONFIG_DATA    0xCFC
+
+/**
+ * Configuration space offsets.
+ */
+#define PCI_VENDOR_ID   0x00
+#define PCI_DEVICE_ID   0x02
+#define PCI_COMMAND     0x04
+#define PCI_REVISION    0x08
+#define PCI_HEADER_TYPE 0x0E
+#define PCI_BAR0        0x10
+#define PCI_SUBSYSTEM   0x2E
+#define PCI_IRQ_LINE    0x3C
+
+/**
+ * Command register bits.
+ */
+#define PCI_COMMAND_IO     0x1
+#define PCI_COMMAND_MEMORY 0x2
+#define PCI_COMMAND_MASTER 0x4
+
+#define PCI_BAR_IO       0x1 //bar is an I/O port range
+#define PCI_HEADER_MULTI 0x80 //device has more than one function
+#define PCI_NO_DEVICE    0xFFFF
+
+/**
+ * Most functions kept from the bus scan.
+ */
+#define PCI_MAX_DEVICES 32
+
+/**
+ * One function found on the bus.
+ */
+typedef struct {
+	u8int bus;
+	u8int slot;
+	u8int func;
+	u16int vendor;
+	u16int device;
+	u16int subsystem;
+	u8int classCode;
+	u8int subclass;
+	u8int irq;
+	u32int bar[6];
+} pci_device;
+
+/**
+ * Reads a double word from a function's configuration space.
+ *
+ * @param bus The bus
+ * @param slot The slot
+ * @param func The function
+ * @param offset The offset; rounded down to a multiple of 4
+ * @return The value
+ */
+u32int pci_read32(int bus, int slot, int func, int offset);
+
+/**
+ * Reads a word from a function's configuration space.
+ *
+ * @param bus The bus
+ * @param slot The slot
+ * @param func The function
+ * @param offset The offset; rounded down to a multiple of 2
+ * @return The value
+ */
+u16int pci_read16(int bus, int slot, int func, int offset);
+
+/**
+ * Writes a word to a function's configuration space.
+ *
+ * @param bus The bus
+ * @param slot The slot
+ * @param func The function
+ * @param offset The offset; rounded down to a multiple of 2
+ * @param value The value
+ */
+void pci_write16(int bus, int slot, int func, int offset, u16int value);
+
+/**
+ * Scans every bus and records the functions found.
+ *
+ * @return The number of functions found
+ */
+int pci_enumerate();
+
+/**
+ * Finds a function by its vendor and device ids.
+ *
+ * @param vendor The vendor id
+ * @param device The device id
+ * @return The function, or NULL if none was found
+ */
+pci_device *pci_find(u16int vendor, u16int device);
+
+/**
+ * Gets a function found by the last scan.
+ *
+ * @param index 0 to the number found - 1
+ * @return The function, or NULL past the end
+ */
+pci_device *pci_get(int index);
+
+/**
+ * Turns on I/O decoding and bus mastering, so the function can answer
+ * port accesses and do DMA.
+ *
+ * @param dev The function
+ */
+void pci_enable(pci_device *dev);
+
+#endif
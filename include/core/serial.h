@@ -1,18 +1,221 @@
 #ifndef _SERIAL_H
 #define _SERIAL_H
 
+#include <system.h>
+
 #define COM1 0x3f8
 #define COM2 0x2f8
 #define COM3 0x3e8
 #define COM4 0x2e8
 
+/**
+ * Interrupt enable register bits.
+ */
+#define IER_RDA  0x01 //received data available
+#define IER_THRE 0x02 //transmit holding register empty
+
+/**
+ * Interrupt identification register values.
+ */
+#define IIR_NONE    0x01 //no interrupt pending
+#define IIR_ID      0x0E //mask for the interrupt id
+#define IIR_THRE    0x02
+#define IIR_RDA     0x04
+#define IIR_LINE    0x06
+#define IIR_TIMEOUT 0x0C
+
+/**
+ * Line status register bits.
+ */
+#define LSR_DR   0x01 //data ready
+#define LSR_THRE 0x20 //transmit holding register empty
+#define LSR_TEMT 0x40 //transmitter empty, including the shift register
+
+/**
+ * Line speeds. The UART clock divided by 16; every speed must divide it.
+ */
+#define SERIAL_MAX_BAUD     115200
+#define SERIAL_DEFAULT_BAUD 115200
+
+/**
+ * Returned by init_serial and serial_set_baud for an unsupported speed.
+ */
+#define SERIAL_BAD_BAUD -1
+
+/**
+ * Size of each ring buffer; a power of two so the indexes can wrap.
+ */
+#define SERIAL_RING_SIZE 256
+
+/**
+ * Bytes the 16550 transmit FIFO holds.
+ */
+#define SERIAL_FIFO_SIZE 16
+
+/**
+ * Single-producer, single-consumer character ring. head only moves on
+ * the producer side and tail only on the consumer side, so neither needs
+ * a lock.
+ */
+typedef struct {
+	volatile char buf[SERIAL_RING_SIZE];
+	volatile u32int head; //next slot to write
+	volatile u32int tail; //next slot to read
+} serial_ring;
+
+/**
+ * Number of ports in the device table, COM1 to COM4.
+ */
+#define SERIAL_PORTS 4
+
+/**
+ * Scratch register value used to find out whether a UART is fitted.
+ */
+#define SERIAL_PROBE_BYTE 0xAE
+
+/**
+ * State of one port. The receive ring is filled by the interrupt handler;
+ * the transmit ring is drained by it. COM1/COM3 share IRQ4 and COM2/COM4
+ * share IRQ3; the handler services every enabled port on the line.
+ */
+typedef struct {
+	int port;
+	int irq;
+	int present;     //a UART answered the probe
+	int irq_enabled;
+	int baud;
+	volatile int tx_active; //transmit interrupts are on
+	volatile u32int rx_dropped; //received while the ring was full
+	serial_ring rx;
+	serial_ring tx;
+} serial_dev;
+
 /**
  * Initializes devices for user interaction, logging, ...
  *
  * @param device The device to initialize
+ * @param baud The line speed; must divide SERIAL_MAX_BAUD
+ * @return The error code
+ */
+int init_serial(int device, int baud);
+
+/**
+ * Checks whether a UART is fitted at a port by writing and reading back
+ * its scratch register. Records the result in the device table.
+ *
+ * @param device The device
+ * @return True if the UART is there
+ */
+int serial_probe(int device);
+
+/**
+ * Gets the address of a port from its number.
+ *
+ * @param number 1 to SERIAL_PORTS
+ * @return The address, or 0 if there is no such port
+ */
+int serial_port(int number);
+
+/**
+ * Gets the driver state of a port in the device table.
+ *
+ * @param number 1 to SERIAL_PORTS
+ * @return The state, or NULL if there is no such port
+ */
+serial_dev *serial_get_dev(int number);
+
+/**
+ * Looks up an output device by the name commands and boot options give
+ * it: a port number, 0 for the console, or virtio.
+ *
+ * @param name The name
+ * @return The device, 0 for the console, or -1 if it is not there
+ */
+int serial_lookup(const char *name);
+
+/**
+ * Writes a block of characters to one device, whatever the active
+ * output device is.
+ *
+ * @param device The device
+ * @param buf The characters
+ * @param len The number of characters
+ */
+void serial_write_device(int device, const char *buf, int len);
+
+/**
+ * Changes the line speed of an initialized device. Output already queued
+ * is sent at the old speed first.
+ *
+ * @param device The device
+ * @param baud The new line speed; must divide SERIAL_MAX_BAUD
+ * @return The error code
+ */
+int serial_set_baud(int device, int baud);
+
+/**
+ * Returns the line speed a device was last set to.
+ *
+ * @param device The device
+ * @return The line speed, or 0 if unknown
+ */
+int serial_get_baud(int device);
+
+/**
+ * Waits until everything queued for a device has left the transmitter.
+ *
+ * @param device The device
+ */
+void serial_flush(int device);
+
+/**
+ * Switches a device to interrupt-driven I/O. The PIC must have been
+ * initialized.
+ *
+ * @param device The device
  * @return The error code
  */
-int init_serial(int device);
+int serial_enable_irq(int device);
+
+/**
+ * Writes a character to a device. Goes through the transmit ring when the
+ * device is interrupt-driven and interrupts are on; otherwise, as during
+ * boot or a panic, waits for the transmitter after draining the ring.
+ *
+ * @param device The device
+ * @param c The character
+ */
+void serial_putc(int device, char c);
+
+/**
+ * Checks whether input is waiting on the active input device.
+ *
+ * @return True if a character can be read without blocking
+ */
+int serial_input_pending();
+
+/**
+ * Reads a character from the active input device without blocking.
+ *
+ * @param c Set to the character read
+ * @return 1 if a character was read, 0 if none was waiting
+ */
+int serial_poll(char *c);
+
+/**
+ * Reads a character from the active input device. A running process is
+ * blocked until the receive interrupt brings input.
+ *
+ * @return The character read
+ */
+char serial_getc();
+
+/**
+ * Serial interrupt handler, called from the stubs in irq.s.
+ *
+ * @param irq The IRQ line that fired
+ */
+void do_serial_irq(int irq);
 
 /**
  * Writes a message to the active serial output device.
@@ -23,6 +226,17 @@ int init_serial(int device);
  */
 int serial_println(const char *msg);
 
+/**
+ * Writes a block of characters to the active serial output device, and
+ * to the mirror device if there is one. The block is queued as a whole
+ * and the transmitter is started once, rather than once per character.
+ *
+ * @param buf The characters
+ * @param len The number of characters
+ * @return The error code
+ */
+int serial_write(const char *buf, int len);
+
 /**
  * Writes a message to the active serial output device.
  *
@@ -41,6 +255,29 @@ int serial_print(const char *msg);
  */
 int set_serial_out(int device);
 
+/**
+ * Sets serial_port_mirror to the given device address. Everything
+ * written to the output device is written to this device as well.
+ *
+ * @param device The device to mirror output to, or 0 for none
+ * @return The error code
+ */
+int set_serial_mirror(int device);
+
+/**
+ * Gets the active output device.
+ *
+ * @return The device
+ */
+int get_serial_out();
+
+/**
+ * Gets the device output is mirrored to.
+ *
+ * @return The device, or 0 for none
+ */
+int get_serial_mirror();
+
 /**
  * Sets serial_port_in to the given device address. All serial input,
  * such as console input via a virutal machine, QEMU/Bochc/etc, will
@@ -34,6 +34,46 @@ typedef struct gdt_entry_struct {
 }
 	__attribute__ ((packed)) gdt_entry;
 
+/**
+ * Hardware task state. The kernel runs in one task; page faults switch to
+ * a second so they always have a good stack to run on.
+ */
+typedef struct tss_struct {
+	u32int prev_task;    //back link to the interrupted task
+	u32int esp0;
+	u32int ss0;
+	u32int esp1;
+	u32int ss1;
+	u32int esp2;
+	u32int ss2;
+	u32int cr3;
+	u32int eip;
+	u32int eflags;
+	u32int eax;
+	u32int ecx;
+	u32int edx;
+	u32int ebx;
+	u32int esp;
+	u32int ebp;
+	u32int esi;
+	u32int edi;
+	u32int es;
+	u32int cs;
+	u32int ss;
+	u32int ds;
+	u32int fs;
+	u32int gs;
+	u32int ldt;
+	u16int trap;
+	u16int iomap_base;
+}
+	__attribute__ ((packed)) tss_entry;
+
+/**
+ * Size of the stack the page fault task runs on.
+ */
+#define FAULT_STACK_SIZE 0x1000
+
 /**
  * Installs a new gate entry into the IDT.
  *
@@ -63,8 +103,18 @@ void init_idt();
 
 /**
  * Creates the global descriptor table and installs it using the defined
- * assembly routine.
+ * assembly routine. Also sets up the kernel and page fault task state
+ * segments and loads the task register.
  */
 void init_gdt();
 
+/**
+ * Sets the page directory the page fault task and the kernel task run
+ * with. Called whenever the directory changes. A task switch does not
+ * save CR3, so the kernel task's must be set for the return to it.
+ *
+ * @param cr3 The physical address of the page directory
+ */
+void set_fault_task_cr3(u32int cr3);
+
 #endif
@@ -0,0 +1,54 @@
+#ifndef _VGA_H
+#define _VGA_H
+
+#include <system.h>
+
+/**
+ * Device id of the VGA text console, for set_serial_out and
+ * set_serial_mirror. It is the CRT controller's index port, so it cannot
+ * clash with a serial port address.
+ */
+#define VGA 0x3d4
+
+/**
+ * Text mode frame buffer and its size in characters.
+ */
+#define VGA_MEMORY 0xB8000
+#define VGA_WIDTH  80
+#define VGA_HEIGHT 25
+
+/**
+ * Light grey on black.
+ */
+#define VGA_DEFAULT_ATTR 0x07
+
+/**
+ * CRT controller registers for the hardware cursor position.
+ */
+#define VGA_CRTC_DATA       0x3d5
+#define VGA_CURSOR_HIGH     0x0E
+#define VGA_CURSOR_LOW      0x0F
+
+/**
+ * Most numeric parameters kept from one escape sequence.
+ */
+#define VGA_MAX_PARAMS 4
+
+/**
+ * Clears the screen and puts the cursor in the top left corner.
+ */
+void vga_init();
+
+/**
+ * Writes characters to the screen. Understands \b \r \n \t and these
+ * escape sequences: cursor movement (ESC[nA ESC[nB ESC[nC ESC[nD and
+ * ESC[r;cH), erase in line (ESC[K), erase in display (ESC[J, ESC[2J),
+ * insert and delete characters (ESC[n@ ESC[nP) and colours (ESC[...m).
+ * The hardware cursor is moved once, at the end.
+ *
+ * @param buf The characters
+ * @param len The number of characters
+ */
+void vga_write(const char *buf, int len);
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef _VIRTIO_H
+#define _VIRTIO_H
+
+#include <system.h>
+
+/**
+ * Device id of the virtio console, for set_serial_out and the log and
+ * trace ports. It is the virtio vendor id, so it cannot clash with a port
+ * address.
+ */
+#define VIRTIO_CON 0x1af4
+
+/**
+ * PCI ids of a legacy (transitional) virtio console.
+ */
+#define VIRTIO_VENDOR         0x1af4
+#define VIRTIO_CONSOLE_DEVICE 0x1003
+
+/**
+ * Legacy virtio-pci registers, as offsets into BAR0's I/O range.
+ */
+#define VIRTIO_DEVICE_FEATURES 0x00
+#define VIRTIO_GUEST_FEATURES  0x04
+#define VIRTIO_QUEUE_PFN       0x08
+#define VIRTIO_QUEUE_SIZE      0x0C
+#define VIRTIO_QUEUE_SELECT    0x0E
+#define VIRTIO_QUEUE_NOTIFY    0x10
+#define VIRTIO_DEVICE_STATUS   0x12
+#define VIRTIO_ISR_STATUS      0x13
+
+/**
+ * Device status bits.
+ */
+#define VIRTIO_STATUS_ACKNOWLEDGE 0x01
+#define VIRTIO_STATUS_DRIVER      0x02
+#define VIRTIO_STATUS_DRIVER_OK   0x04
+#define VIRTIO_STATUS_FAILED      0x80
+
+/**
+ * Console queues, without the multiport feature.
+ */
+#define VIRTIO_CONSOLE_RX 0
+#define VIRTIO_CONSOLE_TX 1
+
+/**
+ * Largest queue the driver can hold. Legacy devices pick the size.
+ */
+#define VIRTIO_MAX_QUEUE 256
+
+/**
+ * Legacy queues are placed by page frame number.
+ */
+#define VIRTIO_PAGE_SIZE 4096
+
+/**
+ * Transmit buffers, each holding one write.
+ */
+#define VIRTIO_TX_BUFFERS     16
+#define VIRTIO_TX_BUFFER_SIZE 1024
+
+/**
+ * Pauses to wait for a free transmit buffer before giving up on the
+ * device. Writes run with interrupts off, so a host that stops taking
+ * output must not hang the kernel.
+ */
+#define VIRTIO_TX_SPIN 1000000
+
+#define VIRTQ_DESC_F_NEXT  0x1
+#define VIRTQ_DESC_F_WRITE 0x2
+
+#define VIRTQ_AVAIL_F_NO_INTERRUPT 0x1
+
+/**
+ * Descriptor: one buffer in guest physical memory.
+ */
+typedef struct {
+	u32int addr;
+	u32int addrHigh;
+	u32int len;
+	u16int flags;
+	u16int next;
+} __attribute__ ((packed)) virtq_desc;
+
+/**
+ * Ring of descriptors the driver offers the device.
+ */
+typedef struct {
+	u16int flags;
+	volatile u16int idx;
+	u16int ring[VIRTIO_MAX_QUEUE];
+} __attribute__ ((packed)) virtq_avail;
+
+/**
+ * Descriptor the device has finished with.
+ */
+typedef struct {
+	u32int id;
+	u32int len;
+} __attribute__ ((packed)) virtq_used_elem;
+
+/**
+ * Ring of descriptors the device hands back.
+ */
+typedef struct {
+	u16int flags;
+	volatile u16int idx;
+	virtq_used_elem ring[VIRTIO_MAX_QUEUE];
+} __attribute__ ((packed)) virtq_used;
+
+/**
+ * Driver side of one virtqueue.
+ */
+typedef struct {
+	int size;
+	virtq_desc *desc;
+	virtq_avail *avail;
+	virtq_used *used;
+	u16int lastUsed; //used ring entries already reclaimed
+	int numFree;
+	u16int freeHead; //free descriptors are chained through next
+} virtqueue;
+
+/**
+ * Finds a virtio console on the PCI bus and brings it up.
+ *
+ * @return True if a console is ready for output
+ */
+int virtio_console_init();
+
+/**
+ * Tests if the virtio console was found and brought up.
+ *
+ * @return True if it is ready
+ */
+int virtio_console_ready();
+
+/**
+ * Writes characters to the host through the virtio console. Waits only
+ * when every transmit buffer is still held by the device, and gives the
+ * console up if none comes back within VIRTIO_TX_SPIN pauses.
+ *
+ * @param buf The characters
+ * @param len The number of characters
+ * @return The number written; less than len if the console is not ready
+ *         or was given up
+ */
+int virtio_console_write(const char *buf, int len);
+
+/**
+ * Gets the number of bytes sent through the virtio console.
+ *
+ * @return The number of bytes
+ */
+u32int virtio_console_sent();
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef _MEM_FREEINDEX
+#define _MEM_FREEINDEX
+
+#include <system.h>
+#include <boolean.h>
+#include <mem/memoryControl.h>
+
+/**
+ * Small free blocks are kept in fast bins, one per FAST_BIN_SPACING bytes of block size.
+ * Anything of FREE_TREE_MIN bytes or more goes in a balanced tree ordered by size then address.
+ */
+#define FAST_BINS 32
+#define FAST_BIN_SPACING 16
+#define FREE_TREE_MIN (FAST_BINS * FAST_BIN_SPACING)
+
+/**
+ * Adds a free block to the fast bins or the size tree
+ *
+ * @param block - the free block
+ */
+void indexFree(cmcb *block);
+
+/**
+ * Removes a free block from the fast bins or the size tree. The block's size must not have
+ * changed since it was indexed.
+ *
+ * @param block - the free block
+ */
+void unindexFree(cmcb *block);
+
+/**
+ * Finds a free block for a request. Small requests take the first block that fits from the
+ * smallest fast bin that has one; larger ones take the smallest block in the tree that fits.
+ *
+ * @param trueSize - size of the block needed, including structs
+ * @return cmcb * to the free block, or NULL if none fit
+ */
+cmcb *findFreeFit(int trueSize);
+
+/**
+ * Returns the root of the size tree
+ *
+ * @return cmcb * to the root, or NULL if the tree is empty
+ */
+cmcb *getSizeTree();
+
+#endif
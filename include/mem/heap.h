@@ -10,20 +10,39 @@
 #define KHEAP_SIZE 0x1000000
 
 /**
- * Heap allocation header.
+ * Marks a valid block header/footer.
+ */
+#define KHEAP_MAGIC 0x4B484550
+
+/**
+ * Index id of a block that is not a hole (allocated, or not indexed).
+ */
+#define KHEAP_USED -1
+
+/**
+ * Heap allocation header. A hole's index_id is its slot in the index
+ * table; an allocated block's is KHEAP_USED.
  */
 typedef struct {
+	u32int magic;
 	int size;
 	int index_id;
 } header;
 
 /**
- * Heap allocation footer.
+ * Heap allocation footer. Holds a copy of the header's magic and size so
+ * that the block before a freed block can be found; index_id is not kept
+ * current here.
  */
 typedef struct {
 	header head;
 } footer;
 
+/**
+ * Smallest block worth splitting off as a hole.
+ */
+#define KHEAP_MIN_HOLE (sizeof(header) + sizeof(footer) + 16)
+
 typedef struct {
 	int size;
 	int empty;
@@ -31,7 +50,8 @@ typedef struct {
 } index_entry;
 
 /**
- * Kernel heap index table.
+ * Kernel heap index table. Holes are kept sorted by size in slots
+ * [0, id), so the first one that fits is the best fit.
  */
 typedef struct {
 	index_entry table[TABLE_SIZE];
@@ -44,6 +64,7 @@ typedef struct {
 typedef struct {
 	index_table index;
 	u32int base;
+	u32int end;
 	u32int max_size;
 	u32int min_size;
 } heap;
@@ -70,11 +91,13 @@ u32int _kmalloc(u32int size, int align, u32int *phys_addr);
 u32int kmalloc(u32int size);
 
 /**
- * Free kernel memory.
+ * Free kernel memory. The block is merged with any neighbouring holes and
+ * returned to the heap index. Memory handed out before the kernel heap was
+ * created is never freed.
  *
- * @return
+ * @param addr The address returned by kmalloc
  */
-u32int kfree();
+void kfree(u32int addr);
 
 /**
  * Initialize the kernel heap, and set it as the current heap.
@@ -83,6 +106,7 @@ void init_kheap();
 
 /**
  * Allocates some memory using the given heap. Can specify page-alignment.
+ * The heap is expanded up to its maximum size when no hole fits.
  *
  * @param size The amount of memory to allocate
  * @param hp The heap to allocate on
@@ -94,7 +118,7 @@ u32int alloc(u32int size, heap *hp, int align);
 /**
  * Create a new heap.
  *
- * @param base Physical start address of the heap
+ * @param base Start address of the heap; the first min bytes must be mapped
  * @param max Maximum size the heap may grow to
  * @param min Minium/Initial size
  * @return The address of the heap
@@ -0,0 +1,144 @@
+#ifndef _MEM_HEAPPROFILE
+#define _MEM_HEAPPROFILE
+
+#include <system.h>
+#include <boolean.h>
+#include <mem/memoryControl.h>
+
+/**
+ * Number of live blocks the profiler can track at once. Must be a power of two.
+ */
+#define PROFILE_BLOCKS 1024
+
+/**
+ * Number of distinct allocation sites the profiler can track
+ */
+#define PROFILE_SITES 64
+
+typedef struct allocSite{
+	void *caller; //return address into the code that called the heap
+	void *callerParent; //return address one frame further up, NULL if unknown
+	int liveBytes;
+	int liveBlocks;
+	int allocations; //allocations since profiling was turned on
+} allocSite;
+
+typedef struct profileRecord{
+	cmcb *block; //NULL if the slot is empty
+	allocSite *site;
+	u32int time; //time stamp of the allocation
+	int size;
+} profileRecord;
+
+/**
+ * Turns profiling on or off. Turning it on clears anything recorded before.
+ *
+ * @param on - true to start recording allocations
+ */
+void setProfiling(boolean on);
+
+/**
+ * Returns whether allocations are being recorded
+ *
+ * @return boolean
+ */
+boolean isProfiling();
+
+/**
+ * Records a new allocation
+ *
+ * @param block - the allocated block
+ * @param frame - frame of the outermost heap function called, its return address is the site
+ */
+void profileAlloc(cmcb *block, void **frame);
+
+/**
+ * Updates the recorded size of a block that was resized in place
+ *
+ * @param block - the allocated block
+ */
+void profileResize(cmcb *block);
+
+/**
+ * Forgets a block that is being freed
+ *
+ * @param block - the allocated block
+ */
+void profileFree(cmcb *block);
+
+/**
+ * Returns the table of allocation sites
+ *
+ * @param count - set to the number of sites in use
+ * @return allocSite * to the first site
+ */
+allocSite *getProfileSites(int *count);
+
+/**
+ * Returns the live block records, indexed by a hash of the block address
+ *
+ * @return profileRecord * to an array of PROFILE_BLOCKS records
+ */
+profileRecord *getProfileRecords();
+
+/**
+ * Returns the number of cycles profiling has been on for
+ *
+ * @return cycles since profiling was turned on, or until it was turned off
+ */
+u32int getProfileCycles();
+
+/**
+ * Returns the number of allocations that could not be recorded because a table was full
+ *
+ * @return number of allocations missed
+ */
+int getProfileDropped();
+
+/**
+ * Turns allocation tracing on or off. While on, every allocation and free is written to the
+ * serial port as a record tools/heapbench can replay:
+ *	HT a <id> <size>
+ *	HT f <id>
+ * The id is the block's address, so it is unique among live blocks.
+ *
+ * @param on - true to start writing records
+ */
+void setTracing(boolean on);
+
+/**
+ * Returns whether allocations are being traced
+ *
+ * @return boolean
+ */
+boolean isTracing();
+
+/**
+ * Sends trace records to their own serial port instead of the console
+ *
+ * @param device - the port, or 0 for the console
+ */
+void setTraceDevice(int device);
+
+/**
+ * Gets the port trace records are sent to
+ *
+ * @return the port, or 0 for the console
+ */
+int getTraceDevice();
+
+/**
+ * Writes the trace record of a new allocation
+ *
+ * @param block - the allocated block
+ */
+void traceAlloc(cmcb *block);
+
+/**
+ * Writes the trace record of a free
+ *
+ * @param block - the block being freed
+ */
+void traceFree(cmcb *block);
+
+#endif
@@ -11,6 +11,29 @@
 
 #define FREE 0
 #define ALLOCATED 1
+#define QUARANTINED 2 //freed guarded block held back from reuse, see HEAP_GUARD_RATE
+
+/**
+ * Virtual range reserved for the heap. Frames are only mapped in as its pages are first touched.
+ */
+#define HEAP_VIRT_BASE 0x10000000
+#define HEAP_VIRT_SIZE 0x1000000
+
+/**
+ * Where the heap starts. Host builds (tools/heapbench) define HOST_HEAP and run the heap in an
+ * arena they allocate themselves.
+ */
+#ifdef HOST_HEAP
+extern void *hostArena;
+#define HEAP_START hostArena
+#else
+#define HEAP_START ((void*)HEAP_VIRT_BASE)
+#endif
+
+/**
+ * Smallest amount the heap grows or shrinks by at once
+ */
+#define HEAP_GROW_STEP 0x4000
 
 typedef struct cmcb{
 	int type;
@@ -18,9 +41,24 @@ typedef struct cmcb{
 	int size;
 	int memSize;
 	const char *name;
+	boolean zeroed; //free block whose memory is known to be all zero
 
 	struct cmcb *next;
 	struct cmcb *prev;
+
+	int owner; //pid of the process that allocated the block, 0 for the kernel
+	memAccount *account; //usage counters the block is charged to
+	struct cmcb *ownerNext; //other blocks of the same owner
+	struct cmcb *ownerPrev;
+
+	//free blocks only: links in the size tree, or in a fast bin where left and right are the
+	//previous and next blocks in the bin
+	struct cmcb *left;
+	struct cmcb *right;
+	struct cmcb *parent;
+	int height;
+
+	int guardSize; //guarded allocations: bytes requested, the canary follows them. 0 if not guarded
 } cmcb;
 
 typedef struct lmcb{
@@ -30,7 +68,72 @@ typedef struct lmcb{
 } lmcb;
 
 /**
- * Initializes the heap to the provided size and creates a free mem block across it
+ * Smallest free block worth splitting off, anything smaller stays with the allocation
+ */
+#define MIN_FREE_BLOCK ((int)(sizeof(struct cmcb) + sizeof(struct lmcb) + 16))
+
+/**
+ * Guard mode. One in every HEAP_GUARD_RATE allocations gets a canary after the requested bytes,
+ * and is poisoned and quarantined when freed so use after free shows up too. Headers are checked
+ * on every free and by a background sweep from the idle process. 0 turns it off; build with
+ * -DHEAP_GUARD_RATE=100 to guard about 1% of allocations, or change it with the heapGuard command.
+ */
+#ifndef HEAP_GUARD_RATE
+#define HEAP_GUARD_RATE 0
+#endif
+#define GUARD_BYTES 4
+#define GUARD_POISON 0xDD
+#define HEAP_QUARANTINE 16 //freed guarded blocks held back from reuse
+#define GUARD_SWEEP_BLOCKS 32 //blocks checked per call from the idle process
+
+#define GUARD_BAD_HEADER 1
+#define GUARD_BAD_CANARY 2
+#define GUARD_BAD_POISON 3
+#define GUARD_DOUBLE_FREE 4
+
+typedef struct guardReport{
+	int rate; //one in this many allocations is guarded, 0 if off
+	int guarded; //guarded blocks allocated
+	int quarantined; //blocks in quarantine now
+	int sweeps; //full passes over the heap completed
+	int errors; //corruption found
+	int lastKind; //GUARD_* kind of the last error
+	void *lastBlock; //block the last error was found in
+	const char *lastName; //process that allocated it
+} guardReport;
+
+/**
+ * Number of log2 size buckets in the heap histograms. Bucket i counts blocks of 2^(i+5) up to
+ * 2^(i+6) bytes, with the first and last buckets also taking anything smaller or larger.
+ */
+#define HEAP_HIST_BUCKETS 16
+
+/**
+ * Number of recent allocate/free timings kept for the latency report
+ */
+#define HEAP_LATENCY_SAMPLES 128
+
+typedef struct heapStats{
+	int heapSize; //bytes currently mapped
+	int totalFree;
+	int totalAllocated;
+	int freeBlocks;
+	int allocatedBlocks;
+	int largestFree;
+	int fragmentation; //percent of free memory outside the largest free block
+	int freeHist[HEAP_HIST_BUCKETS];
+	int allocatedHist[HEAP_HIST_BUCKETS];
+} heapStats;
+
+typedef struct latencyLog{
+	u32int samples[HEAP_LATENCY_SAMPLES]; //cycles per call, the oldest is overwritten first
+	int count; //number of samples recorded, at most HEAP_LATENCY_SAMPLES
+	int next; //where the next sample goes
+} latencyLog;
+
+/**
+ * Initializes the heap to the provided size and creates a free mem block across it.
+ * The heap grows past this size on demand, up to HEAP_VIRT_SIZE.
  *
  * @param size - size of heap in bytes
  * @return boolean - boolean denoting if heap was initialized
@@ -45,6 +148,37 @@ boolean initializeHeap(int size);
  */
 void *allocateMemory(int size);
 
+/**
+ * Allocates a memory block whose address is a multiple of the given alignment. The space in
+ * front of the aligned address stays in the free list, and the block is freed like any other
+ * with deallocateMemory.
+ *
+ * @param size - size of memory to allocate in bytes
+ * @param align - required alignment in bytes, a power of two
+ * @return pointer to the aligned memory, or NULL if it could not be allocated
+ */
+void *allocateAligned(int size, int align);
+
+/**
+ * Allocates zeroed memory for an array. Pre-zeroed free blocks are used when one fits, so the
+ * memory only has to be cleared when none do.
+ *
+ * @param count - number of elements
+ * @param size - size of each element in bytes
+ * @return pointer to the zeroed memory, or NULL if it could not be allocated
+ */
+void *callocMemory(int count, int size);
+
+/**
+ * Changes the size of an allocated block. The block shrinks in place, and grows in place when
+ * the block physically after it is free and large enough; otherwise it is moved.
+ *
+ * @param memPointer - pointer to the mem block, or NULL to allocate a new one
+ * @param size - new size in bytes, or 0 to free the block
+ * @return pointer to the resized block, or NULL if it could not be resized (the block is untouched)
+ */
+void *reallocateMemory(void *memPointer, int size);
+
 /**
  * Deallocates the block of memory at the mempointer
  *
@@ -53,6 +187,83 @@ void *allocateMemory(int size);
  */
 boolean deallocateMemory(void *memPointer);
 
+/**
+ * Zeroes one free block that is not yet known to be zero, refilling the pool callocMemory takes
+ * pre-zeroed blocks from. Called from the idle process.
+ *
+ * @return boolean - true if a block was zeroed
+ */
+boolean scrubFreeMemory();
+
+/**
+ * Frees every block owned by a process. Called when the process exits. A block whose header
+ * is damaged cannot be freed safely, so it is leaked on purpose and dropped from the process'
+ * list; the rest of the list is only followed if the next block looks intact.
+ *
+ * @param p - the process
+ * @return number of blocks freed
+ */
+int freeProcessMemory(pcb *p);
+
+/**
+ * Returns the usage counters of the allocations made while no process was running
+ *
+ * @return memAccount * for the kernel
+ */
+memAccount *getKernelAccount();
+
+/**
+ * Fills in a summary of the free and allocated lists
+ *
+ * @param stats - struct to fill in
+ * @return boolean - false if the heap is not initialized
+ */
+boolean getHeapStats(heapStats *stats);
+
+/**
+ * Returns the cycle counts of recent allocateMemory calls
+ *
+ * @return latencyLog * of allocate timings
+ */
+latencyLog *getAllocLatency();
+
+/**
+ * Returns the cycle counts of recent deallocateMemory calls
+ *
+ * @return latencyLog * of free timings
+ */
+latencyLog *getFreeLatency();
+
+/**
+ * Discards all recorded allocate and free timings
+ */
+void resetLatency();
+
+/**
+ * Sets how many allocations there are per guarded one. Setting it to 0 turns guard mode off and
+ * releases the quarantine.
+ *
+ * @param rate - one in this many allocations is guarded, 0 for none
+ */
+void setHeapGuard(int rate);
+
+/**
+ * Checks heap headers, canaries of guarded blocks and poison of quarantined blocks, picking up
+ * where the last call stopped. The walk starts over if the heap changed in between. Partial
+ * sweeps are for the idle process and only run in guard mode.
+ *
+ * @param maxBlocks - most blocks to check, 0 for the whole heap
+ * @return number of errors found
+ */
+int heapGuardSweep(int maxBlocks);
+
+/**
+ * Fills in the guard mode counters and the last error found
+ *
+ * @param report - struct to fill in
+ */
+void getGuardReport(guardReport *report);
+
 /**
  * Returns a boolean telling if all the memory is empty
  *
@@ -2,9 +2,58 @@
 #define _PAGING_H
 
 #include <system.h>
+#include <core/multiboot.h>
 
 #define PAGE_SIZE 0x1000
 
+/**
+ * Number of freed frames remembered for reuse without a bitmap scan.
+ */
+#define FRAME_STACK_SIZE 1024
+
+/**
+ * Most usable RAM regions kept from the boot memory map.
+ */
+#define MAX_MEM_REGIONS 32
+
+/**
+ * A region of usable physical memory.
+ */
+typedef struct {
+	u32int base;
+	u32int length;
+} mem_region;
+
+/**
+ * Most demand-zero regions that can be registered at once.
+ */
+#define MAX_FAULT_REGIONS 16
+
+/**
+ * Page fault error code bits.
+ */
+#define PF_PRESENT 0x1 //protection violation on a present page
+#define PF_WRITE   0x2 //the access was a write
+#define PF_USER    0x4 //the access came from user mode
+
+/**
+ * An address range whose pages are mapped in when first touched. If
+ * allows is set, only addresses it accepts are mapped.
+ */
+typedef struct {
+	u32int start;
+	u32int end;
+	int (*allows)(u32int addr);
+} fault_region;
+
+/**
+ * 4MB pages (PSE).
+ */
+#define LARGE_PAGE_SIZE 0x400000
+#define PDE_LARGE 0x80
+#define CR4_PSE 0x10
+#define CPUID_PSE 0x8
+
 /**
  * Page entry structure
  * Describes a single page in memory
@@ -60,16 +109,80 @@ void clear_bit(u32int addr);
 u32int get_bit(u32int addr);
 
 /**
- * Finds the first free page frame.
+ * Finds a free page frame. Scans the bitmap a word at a time, starting at
+ * the word the last scan stopped at and wrapping around once.
  *
- * @return The first free page frame
+ * @return A free page frame
  */
 u32int first_free();
 
+/**
+ * Takes a free page frame, from the free-frame stack if it holds one and
+ * from the bitmap otherwise.
+ *
+ * @return A free page frame
+ */
+u32int alloc_frame();
+
+/**
+ * Returns the number of frames not in use.
+ *
+ * @return The number of free frames
+ */
+u32int get_free_frames();
+
+/**
+ * Returns the number of frames in use.
+ *
+ * @return The number of used frames
+ */
+u32int get_used_frames();
+
+/**
+ * Checks whether the CPU supports 4MB pages.
+ *
+ * @return True if PSE is supported
+ */
+int has_pse();
+
+/**
+ * Identity maps a single 4KB page and marks its frame in use.
+ *
+ * @param addr The address of the page
+ */
+void identity_page(u32int addr);
+
+/**
+ * Identity maps a 4MB region with a single directory entry and marks its
+ * frames in use. PSE must be enabled before paging is.
+ *
+ * @param addr The 4MB-aligned address of the region
+ */
+void map_large_page(u32int addr);
+
+/**
+ * Adds a region of usable RAM, trimmed to whole frames.
+ *
+ * @param base The start of the region
+ * @param length The length of the region
+ */
+void add_mem_region(u32int base, u32int length);
+
+/**
+ * Sizes physical memory from the multiboot information. Only regions the
+ * memory map reports as available are used; reserved, ACPI and NVS
+ * regions stay marked in use. Without a memory map the mem_upper field is
+ * used, and without either the default size is kept.
+ *
+ * @param info The multiboot information structure
+ */
+void detect_memory(multiboot_info *info);
+
 /**
  * Initializes the kernel page directory and initial kernel heap area. Performs
  * identity mapping of the kernel frames such that the virtual addresses are
- * equivalent to the physical addresses.
+ * equivalent to the physical addresses. The identity region uses 4MB pages
+ * when the CPU supports them.
  */
 void init_paging();
 
@@ -84,6 +197,7 @@ void load_page_dir(page_dir *new_page_dir);
 
 /**
  * Finds and returns a page, allocating a new page table if necessary.
+ * Returns 0 for addresses mapped with a 4MB page.
  *
  * @param addr The address of the page
  * @param dir The page directory
@@ -99,4 +213,65 @@ page_entry *get_page(u32int addr, page_dir *dir, int make_table);
 */
 void new_frame(page_entry *page);
 
+/**
+ * Releases the frame behind a page in the frame bitmap and marks the page
+ * not present. The frame is pushed on the free-frame stack so the next
+ * new_frame can take it without a scan.
+ *
+ * @param page The page to release the frame of
+ */
+void free_frame(page_entry *page);
+
+/**
+ * Flushes the TLB entry for a single page. Needed after unmapping a page
+ * that may have been accessed.
+ *
+ * @param addr The virtual address of the page
+ */
+void invalidate_page(u32int addr);
+
+/**
+ * Registers a demand-zero region. A not-present fault inside it gets a
+ * zeroed frame instead of a panic. The page tables covering the region
+ * must already exist.
+ *
+ * @param start The first address of the region, page aligned
+ * @param end The address after the region, page aligned
+ * @param allows Decides which addresses in the region may be mapped, or 0 for all
+ * @return 1 on success, 0 if the registry is full
+ */
+int register_region(u32int start, u32int end, int (*allows)(u32int addr));
+
+/**
+ * Removes a demand-zero region. Pages already mapped in stay mapped.
+ *
+ * @param start The first address of the region
+ */
+void unregister_region(u32int start);
+
+/**
+ * Finds the demand-zero region containing an address.
+ *
+ * @param addr The address
+ * @return The region, or 0 if the address is in none
+ */
+fault_region *find_region(u32int addr);
+
+/**
+ * Resolves a page fault by mapping a zeroed frame, if the faulting
+ * address is not present and lies in a demand-zero region.
+ *
+ * @param addr The faulting address, from CR2
+ * @param error The error code pushed by the CPU
+ * @return 1 if the fault was resolved, 0 if it is a real fault
+ */
+int handle_page_fault(u32int addr, u32int error);
+
+/**
+ * Returns the number of pages mapped in on demand.
+ *
+ * @return The number of demand faults
+ */
+u32int get_demand_faults();
+
 #endif
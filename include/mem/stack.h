@@ -0,0 +1,81 @@
+#ifndef _STACK_H
+#define _STACK_H
+
+#include <system.h>
+#include <mem/paging.h>
+
+/**
+ * Virtual range process stacks are carved from. Each stack gets its own
+ * slot; the slot's pages are mapped in on demand from the top down to the
+ * stack's limit, and everything below the limit, at least one page, is a
+ * guard that is never mapped.
+ */
+#define STACK_REGION_BASE 0x11000000
+#define STACK_SLOT_SIZE   0x10000
+#define MAX_STACKS        64
+#define STACK_REGION_SIZE (STACK_SLOT_SIZE * MAX_STACKS)
+
+/**
+ * Stack limits, in bytes.
+ */
+#define STACK_DEFAULT_LIMIT 0x4000
+#define STACK_MAX_LIMIT     (STACK_SLOT_SIZE - PAGE_SIZE)
+
+/**
+ * Registers the stack region with the page fault handler.
+ *
+ * @return 1 on success, 0 if the region could not be registered
+ */
+int init_stacks();
+
+/**
+ * Reserves a stack slot. No frames are mapped until the stack is used.
+ *
+ * @param limit The most bytes the stack may grow to
+ * @return The address just above the stack, or 0 if no slot is free
+ */
+u32int alloc_stack(u32int limit);
+
+/**
+ * Releases a stack slot and the frames mapped into it.
+ *
+ * @param addr Any address inside the stack
+ */
+void free_stack(u32int addr);
+
+/**
+ * Changes how far a stack may grow. Lowering the limit does not release
+ * pages the stack has already touched.
+ *
+ * @param addr Any address inside the stack
+ * @param limit The most bytes the stack may grow to
+ * @return The lowest address the stack may now use, or 0 if the limit is invalid
+ */
+u32int set_stack_limit(u32int addr, u32int limit);
+
+/**
+ * Returns how far a stack may grow.
+ *
+ * @param addr Any address inside the stack
+ * @return The stack limit in bytes, or 0 if the slot is not in use
+ */
+u32int get_stack_limit(u32int addr);
+
+/**
+ * Returns how much of a stack has frames mapped.
+ *
+ * @param addr Any address inside the stack
+ * @return The committed bytes
+ */
+u32int get_stack_committed(u32int addr);
+
+/**
+ * Checks whether a faulting address lies below the limit of a stack in
+ * use, in its guard area.
+ *
+ * @param addr The faulting address
+ * @return True if the address is a stack overflow
+ */
+int stack_overflowed(u32int addr);
+
+#endif
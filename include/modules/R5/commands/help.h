@@ -17,6 +17,65 @@
     "    --free - Displays free memory\n"\
     "    --allocated - Displays allocated memory")
 
+#define HELP_R5_COMMAND_SHOWPROCESSMEMORY ((const char*) \
+	"Displays the bytes and blocks of heap owned by the kernel and each process,\n"\
+	"the quota limiting each one, and each process's stack limit and how much\n"\
+	"of its stack is in use.\n"\
+	"\n"\
+    "Usage: showProcessMemory [--quota name bytes] [--stack name bytes]\n"\
+    "\n"\
+    "Args:\n"\
+    "    [no args] - Displays the usage of every process\n"\
+    "    --quota name bytes - Limits the process to the given number of bytes, 0 for no limit\n"\
+    "    --stack name bytes - Sets how far the process's stack may grow, in bytes")
+
+#define HELP_R5_COMMAND_HEAPSTATS ((const char*) \
+	"Displays a summary of the heap: free and allocated totals, the largest free\n"\
+	"block, fragmentation, free and used page frames, block size histograms, and\n"\
+	"allocate/free latency percentiles in CPU cycles.\n"\
+	"\n"\
+    "Usage: heapStats [--reset]\n"\
+    "\n"\
+    "Args:\n"\
+    "    [no args] - Displays the summary\n"\
+    "    --reset - Discards the recorded latencies")
+
+#define HELP_R5_COMMAND_HEAPPROFILE ((const char*) \
+	"Records which code allocates heap memory. Shows the sites owning the most live\n"\
+	"bytes and the sites allocating most often, with the age of each site's oldest\n"\
+	"live block. Run tools/symbolize.sh on the output to get function names.\n"\
+	"\n"\
+    "Usage: heapProfile [--on] [--off]\n"\
+    "\n"\
+    "Args:\n"\
+    "    [no args] - Displays the profile\n"\
+    "    --on - Clears the profile and starts recording allocations\n"\
+    "    --off - Stops recording allocations")
+
+#define HELP_R5_COMMAND_HEAPTRACE ((const char*) \
+	"Writes a record for every allocation and free to the terminal. Capture the\n"\
+	"output and replay it on the host with tools/heapbench/heapreplay.\n"\
+	"\n"\
+    "Usage: heapTrace --on|--off|--port n\n"\
+    "\n"\
+    "Args:\n"\
+    "    --on - Starts writing a record for every allocation and free\n"\
+    "    --off - Stops writing records\n"\
+    "    --port n - Writes the records to COMn or virtio, or to the terminal for 0;\n"\
+    "               not the port carrying the event trace")
+
+#define HELP_R5_COMMAND_HEAPGUARD ((const char*) \
+	"Guard mode puts a canary after some allocations and poisons them when freed,\n"\
+	"so overruns and use after free are caught. Shows the guard counters and the\n"\
+	"last corruption found.\n"\
+	"\n"\
+    "Usage: heapGuard [--rate n] [--check]\n"\
+    "\n"\
+    "Args:\n"\
+    "    [no args] - Displays the guard counters\n"\
+    "    --rate n - Guards one in every n allocations, 0 turns guard mode off\n"\
+    "    --check - Checks every block in the heap")
+
 
 
 
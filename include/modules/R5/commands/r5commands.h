@@ -31,4 +31,90 @@ void registerR5PermCommands();
  
 const char *showMemory(char **args, int numArgs);
 
+/**
+ * Displays the heap and stack usage of the kernel and of every process, or sets a process's
+ * quota or stack limit.
+ *
+ * Usage: showProcessMemory [--quota name bytes] [--stack name bytes]
+ *
+ * Args:
+ *	[no args] - Displays the usage of every process
+ *	--quota name bytes - Limits the process to the given number of bytes, 0 for no limit
+ *	--stack name bytes - Sets how far the process's stack may grow
+ *
+ * @param args The arguments to pass to the function
+ * @param numArgs The number of arguments
+ * @return A status message indicating success/failure
+ */
+const char *showProcessMemory(char **args, int numArgs);
+
+/**
+ * Displays a summary of the heap: free and allocated totals, the largest free block, how
+ * fragmented the free memory is, free and used page frames, block size histograms, and
+ * allocate/free latency percentiles.
+ *
+ * Usage: heapStats [--reset]
+ *
+ * Args:
+ *	[no args] - Displays the summary
+ *	--reset - Discards the recorded latencies
+ *
+ * @param args The arguments to pass to the function
+ * @param numArgs The number of arguments
+ * @return A status message indicating success/failure
+ */
+const char *heapStatsCommand(char **args, int numArgs);
+
+/**
+ * Turns the allocation site profiler on or off, or displays the sites that own the most live
+ * memory and the sites that allocate most often. Addresses can be turned into function names
+ * on the host with tools/symbolize.sh.
+ *
+ * Usage: heapProfile [--on] [--off]
+ *
+ * Args:
+ *	[no args] - Displays the profile
+ *	--on - Clears the profile and starts recording allocations
+ *	--off - Stops recording allocations
+ *
+ * @param args The arguments to pass to the function
+ * @param numArgs The number of arguments
+ * @return A status message indicating success/failure
+ */
+const char *heapProfile(char **args, int numArgs);
+
+/**
+ * Turns allocation tracing on or off. While on, every allocation and free is written to the
+ * terminal as a record that tools/heapbench/heapreplay can replay on the host.
+ *
+ * Usage: heapTrace --on|--off|--port n
+ *
+ * Args:
+ *	--on - Starts writing a record for every allocation and free
+ *	--off - Stops writing records
+ *	--port n - Writes the records to COMn, or to the terminal for 0
+ *
+ * @param args The arguments to pass to the function
+ * @param numArgs The number of arguments
+ * @return A status message indicating success/failure
+ */
+const char *heapTrace(char **args, int numArgs);
+
+/**
+ * Displays the heap guard counters and the last corruption found, sets how often allocations
+ * are guarded, or checks the whole heap now.
+ *
+ * Usage: heapGuard [--rate n] [--check]
+ *
+ * Args:
+ *	[no args] - Displays the guard counters
+ *	--rate n - Guards one in every n allocations, 0 turns guard mode off
+ *	--check - Checks every block in the heap
+ *
+ * @param args The arguments to pass to the function
+ * @param numArgs The number of arguments
+ * @return A status message indicating success/failure
+ */
+const char *heapGuard(char **args, int numArgs);
+
 #endif
\ No newline at end of file
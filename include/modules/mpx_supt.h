@@ -88,7 +88,8 @@ void *sys_alloc_mem(u32int size);
 int sys_free_mem(void *ptr);
 
 /**
- * The idle process
+ * The idle process. Uses the spare time to refill the heap's pool of
+ * pre-zeroed memory.
  */
 void idle();
 
@@ -98,4 +99,11 @@ void idle();
  * @return const char pointer name
  */
 const char * getCOPName();
+
+/**
+ * Gets the COP
+ *
+ * @return pcb pointer to the COP, or NULL if no process is running
+ */
+pcb *getCOP();
 #endif
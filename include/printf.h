@@ -0,0 +1,46 @@
+#ifndef _PRINTF_H
+#define _PRINTF_H
+
+#include <stdarg.h>
+#include <system.h>
+
+/**
+ * Size of the stack buffer kprintf formats into before handing the text
+ * to the serial driver.
+ */
+#define KPRINTF_CHUNK 128
+
+/**
+ * Formats a string into a buffer. Supports %d %u %x %s %c %p and %%, each
+ * with an optional - (left align), 0 (pad with zeros) and field width. An
+ * l before the conversion is accepted and ignored.
+ *
+ * @param buf The buffer; always terminated if size is more than 0
+ * @param size The size of the buffer
+ * @param fmt The format
+ * @param args The values to format
+ * @return The length of the whole formatted string, even if it was cut
+ */
+int kvsnprintf(char *buf, int size, const char *fmt, va_list args);
+
+/**
+ * Formats a string into a buffer. See kvsnprintf.
+ *
+ * @param buf The buffer; always terminated if size is more than 0
+ * @param size The size of the buffer
+ * @param fmt The format
+ * @return The length of the whole formatted string, even if it was cut
+ */
+int ksnprintf(char *buf, int size, const char *fmt, ...);
+
+/**
+ * Formats a string to the active serial output device. See kvsnprintf.
+ * Each \n is sent as \r\n. The text is written in chunks of up to
+ * KPRINTF_CHUNK characters rather than a character at a time.
+ *
+ * @param fmt The format
+ * @return The number of characters written
+ */
+int kprintf(const char *fmt, ...);
+
+#endif
@@ -114,4 +114,14 @@ void itoa(int num, char *str, int base);
  */
 void reverse(char *str, int len);
 
+/**
+ * Copies memory. The regions may overlap.
+ *
+ * @param dst The destination
+ * @param src The source
+ * @param n The number of bytes
+ * @return dst
+ */
+void *memmove(void *dst, const void *src, size_t n);
+
 #endif
@@ -50,6 +50,16 @@
  */
 #define GDT_DS_ID 0x02
 
+/**
+ * Kernel task state segment ID.
+ */
+#define GDT_TSS_ID 0x05
+
+/**
+ * Page fault task state segment ID.
+ */
+#define GDT_FAULT_TSS_ID 0x06
+
 /* System Types */
 typedef unsigned int size_t;
 typedef unsigned char u8int;
@@ -70,7 +80,47 @@ static inline int irq_on() {
 }
 
 /**
- * Kernel log message. Sent to active serial device.
+ * Reads the time stamp counter.
+ *
+ * @return The low 32 bits of the number of cycles since reset
+ */
+static inline u32int rdtsc() {
+	u32int lo;
+	asm volatile ("rdtsc"
+	: "=a"(lo)
+	:
+	: "edx");
+	return lo;
+}
+
+/**
+ * Reads the whole time stamp counter, for intervals too long for the low
+ * 32 bits, which wrap in about a second.
+ *
+ * @return The number of cycles since reset
+ */
+static inline unsigned long long rdtsc64() {
+	u32int lo, hi;
+	asm volatile ("rdtsc"
+	: "=a"(lo), "=d"(hi));
+	return (unsigned long long) hi << 32 | lo;
+}
+
+/**
+ * Input clock of the programmable interval timer.
+ */
+#define PIT_HZ 1193182
+
+/**
+ * Measures how many time stamp counter cycles make up a millisecond.
+ *
+ * @return The number of cycles per millisecond
+ */
+u32int tsc_per_ms();
+
+/**
+ * Kernel log message, at info level from the core. Until the dispatcher
+ * is running nothing else drains the log, so it is printed right away.
  *
  * @param msg The message to log
  */
@@ -5,8 +5,10 @@
     command handler
 */
 
+#include <stdarg.h>
 #include <stdint.h>
 #include <string.h>
+#include <printf.h>
 
 #include <core/comHandler.h>
 #include <core/io.h>
@@ -26,71 +28,322 @@
 int continueHandle = 1;
 char buffer[256]; //buffer used for string input from keyboard
 
-functionDef functionDefs[256]; //array of structs containing name and pointer to functions
+functionDef functionDefs[MAX_COMMANDS]; //array of structs containing name and pointer to functions
 int functionInsertPoint = 0;
 
+// Perfect hash of the command names, rebuilt on every registration. A name's
+// first hash picks a bucket, and the bucket's displacement picks its slot.
+short commandSlots[COMMAND_SLOTS]; //index into functionDefs, -1 if empty
+u32int commandDisplace[COMMAND_BUCKETS];
+int commandHashOk = 0; //0 if no displacement was found; lookups then scan
+
+// Prefix trie of the command names, for completion and abbreviations
+commandNode commandTrie[COMMAND_TRIE_NODES] = {{0, -1, -1, -1, 0}}; //node 0 is the root
+int trieInsertPoint = 1;
+
 char comHistory[10][256]; //Array containing 10 previously used commands
 int comHistoryPos = 0; //Current position in comHistory
 
 /*******************************
  * FunctionDef Handling
  *******************************/
+/**
+ * Hashes a command name (FNV-1a)
+ *
+ * @param name - the name
+ * @return the hash
+ */
+u32int hashCommandName(const char *name) {
+	u32int h = 2166136261u;
+	for (; *name != '\0'; name++) {
+		h = (h ^ (u8int) *name) * 16777619u;
+	}
+	return h;
+}
+
+/**
+ * Gets the slot of a name hash under a bucket displacement
+ *
+ * @param h - hash of the name
+ * @param d - the displacement
+ * @return the slot
+ */
+int commandSlot(u32int h, u32int d) {
+	h += d * 0x9E3779B9u; //mix so each displacement gives an unrelated slot
+	h ^= h >> 16;
+	h *= 0x85EBCA6Bu;
+	h ^= h >> 13;
+	return h & (COMMAND_SLOTS - 1);
+}
+
+/**
+ * Rebuilds the perfect hash of every registered name. The fullest buckets are placed
+ * first, each with the smallest displacement that puts all of its names in empty slots.
+ *
+ * @return 1 if a displacement was found for every bucket
+ */
+int buildCommandHash() {
+	static u32int hash[MAX_COMMANDS];
+	static short slot[MAX_COMMANDS];
+	short bucketSize[COMMAND_BUCKETS];
+	int b, i, j, size, fits;
+	u32int d;
+
+	for (i = 0; i < COMMAND_SLOTS; i++) {
+		commandSlots[i] = -1;
+	}
+	for (b = 0; b < COMMAND_BUCKETS; b++) {
+		bucketSize[b] = 0;
+		commandDisplace[b] = 0;
+	}
+	for (i = 0; i < functionInsertPoint; i++) {
+		hash[i] = hashCommandName(functionDefs[i].name);
+		bucketSize[hash[i] % COMMAND_BUCKETS]++;
+	}
+
+	for (size = functionInsertPoint; size > 0; size--) {
+		for (b = 0; b < COMMAND_BUCKETS; b++) {
+			if (bucketSize[b] != size) {
+				continue;
+			}
+			for (d = 0; d < COMMAND_MAX_DISPLACE; d++) {
+				//try to place every name in the bucket
+				fits = 1;
+				for (i = 0; i < functionInsertPoint && fits; i++) {
+					if (hash[i] % COMMAND_BUCKETS != (u32int) b) {
+						continue;
+					}
+					slot[i] = commandSlot(hash[i], d);
+					if (commandSlots[slot[i]] != -1) {
+						fits = 0;
+					}
+					for (j = 0; j < i && fits; j++) { //two of its own names in one slot
+						if (hash[j] % COMMAND_BUCKETS == (u32int) b && slot[j] == slot[i]) {
+							fits = 0;
+						}
+					}
+				}
+				if (fits) {
+					break;
+				}
+			}
+			if (d == COMMAND_MAX_DISPLACE) {
+				return 0;
+			}
+
+			commandDisplace[b] = d;
+			for (i = 0; i < functionInsertPoint; i++) {
+				if (hash[i] % COMMAND_BUCKETS == (u32int) b) {
+					commandSlots[slot[i]] = i;
+				}
+			}
+		}
+	}
+	return 1;
+}
+
+/**
+ * Adds a name to the prefix trie. If there are not enough nodes left for it the
+ * trie is left as it was; the name can still be run in full, just not abbreviated.
+ *
+ * @param name - the name
+ * @param index - index of its functionDef
+ */
+void addCommandPrefix(const char *name, int index) {
+	int node = 0, child, need;
+	short *link;
+	const char *rest;
+
+	//nodes needed for the part of the name not already in the trie
+	for (rest = name; *rest != '\0'; rest++) {
+		for (child = commandTrie[node].child; child != -1 && commandTrie[child].c != *rest;
+				child = commandTrie[child].sibling);
+		if (child == -1) {
+			break;
+		}
+		node = child;
+	}
+	need = strlen(rest);
+	if (trieInsertPoint + need > COMMAND_TRIE_NODES) {
+		return;
+	}
+
+	node = 0;
+	commandTrie[0].count++;
+	for (; *name != '\0'; name++) {
+		//siblings are kept in character order, so completions print sorted
+		for (link = &commandTrie[node].child; *link != -1 && commandTrie[*link].c < *name;
+				link = &commandTrie[*link].sibling);
+		child = *link;
+		if (child == -1 || commandTrie[child].c != *name) {
+			child = trieInsertPoint++;
+			commandTrie[child].c = *name;
+			commandTrie[child].child = -1;
+			commandTrie[child].command = -1;
+			commandTrie[child].count = 0;
+			commandTrie[child].sibling = *link;
+			*link = child;
+		}
+		node = child;
+		commandTrie[node].count++;
+	}
+	commandTrie[node].command = index;
+}
+
+/**
+ * Finds the trie node a prefix leads to
+ *
+ * @param prefix - the start of a name
+ * @return the node, or -1 if no name starts with prefix
+ */
+int findCommandPrefix(const char *prefix) {
+	int node = 0;
+	for (; *prefix != '\0' && node != -1; prefix++) {
+		for (node = commandTrie[node].child; node != -1 && commandTrie[node].c != *prefix;
+				node = commandTrie[node].sibling);
+	}
+	return node;
+}
+
 /**
  * Adds function definition struct, created from provided params to the functionDefs array
- * This allows the function to be called in the command handler by its name
+ * This allows the function to be called in the command handler by its name. The name is
+ * added to the perfect hash and the prefix trie.
  *
  * @param name - string representation of the function
  * @param helpString - const string to be displayed for help
  * @param funcPointer - pointer to the function, must return const char* and take in arguments: char** args and int numArgs
  */
 void addFunctionDef(char *name, const char *helpString, const char *(funcPointer)(char **args, int numArgs)) {
-	if (functionInsertPoint == 256) { //check if array full
+	if (functionInsertPoint == MAX_COMMANDS) { //check if array full
 		serial_println("");
 		serial_println("WARNING: Attempted to add more functions than allowed");
 		return;
 	}
-	functionDef temp; //create new functionDef
-	temp.name = name; //set all fields
-	temp.funcPointer = funcPointer;
-	temp.helpString = helpString;
-	functionDefs[functionInsertPoint] = temp; //set functionDef in array
+	functionDef *def = getFunctionDef(name);
+	if (def != NULL && strcmp(def->name, name) == 0) { //abbreviations of other names are fine
+		serial_println("");
+		serial_println("WARNING: Attempted to add a function twice");
+		return;
+	}
+	def = &functionDefs[functionInsertPoint]; //set all fields
+	def->name = name;
+	def->funcPointer = funcPointer;
+	def->helpString = helpString;
 	functionInsertPoint++; //increment insertPoint
+
+	commandHashOk = buildCommandHash();
+	addCommandPrefix(name, functionInsertPoint - 1);
 }
 
 /**
- * Gets the functionDef struct corresponding to the name provided, returns a functionDef with null
- * funcPointer if none are found
+ * Gets the functionDef struct corresponding to the name provided. The name is found through
+ * the perfect hash; if it is not a full name, it may be an abbreviation that only one command
+ * starts with.
  *
- * @param name - name of the functionDef
- * @return functionDef
+ * @param name - name of the functionDef, or a unique start of one
+ * @return functionDef * in the table, or NULL if none is found
  */
-functionDef getFunctionDef(char *name) {
-	int i = 0;
-	for (; i < functionInsertPoint; i++) { //loop through functionDefs
-		if (strcmp(functionDefs[i].name, name) == 0) { //check for correct name
-			return functionDefs[i]; //if name correct return functionDef
+functionDef *getFunctionDef(char *name) {
+	int i, node;
+
+	if (commandHashOk) {
+		u32int h = hashCommandName(name);
+		i = commandSlots[commandSlot(h, commandDisplace[h % COMMAND_BUCKETS])];
+		if (i != -1 && strcmp(functionDefs[i].name, name) == 0) {
+			return &functionDefs[i];
+		}
+	} else {
+		for (i = 0; i < functionInsertPoint; i++) { //no perfect hash, loop through functionDefs
+			if (strcmp(functionDefs[i].name, name) == 0) {
+				return &functionDefs[i];
+			}
+		}
+	}
+
+	//an abbreviation only one name starts with; the rest of the chain is that name
+	node = *name == '\0' ? -1 : findCommandPrefix(name);
+	if (node == -1 || commandTrie[node].count != 1) {
+		return NULL;
+	}
+	while (commandTrie[node].command == -1) {
+		if ((node = commandTrie[node].child) == -1) {
+			return NULL;
 		}
 	}
-	functionDef nullDef; //create blank functionDef
-	nullDef.funcPointer = NULL;
-	return nullDef;
+	return &functionDefs[commandTrie[node].command];
 }
 
 /**
  * Gets the help string from the struct for the function name provided
  *
- * @param name - name associated witht he struct from which to get the help string
+ * @param name - name associated witht he struct from which to get the help string, or a unique start of one
  * @return const char* help string
  */
 const char *getHelpString(char *name) {
-	int i = 0;
-	for (; i < functionInsertPoint; i++) { //loop through functionDefs
-		if (strcmp(functionDefs[i].name, name) == 0) { //if name correct
-			return functionDefs[i].helpString; //return helpstring for functionDef
+	functionDef *def = getFunctionDef(name);
+	if (def == NULL) {
+		return HELP_INVALID_ARGUMENTS; //return unkown command string
+	}
+	return def->helpString; //return helpstring for functionDef
+}
+
+/**
+ * Finds how far a partly typed command name can be completed
+ *
+ * @param prefix - the start of a name
+ * @param rest - set to the characters every matching name has after prefix
+ * @param size - size of rest
+ * @return the number of names starting with prefix
+ */
+int completeCommand(const char *prefix, char *rest, int size) {
+	int start = findCommandPrefix(prefix);
+	int node = start, len = 0;
+
+	rest[0] = '\0';
+	if (start == -1) {
+		return 0;
+	}
+	//follow the chain while there is only one way on
+	while (commandTrie[node].command == -1 && commandTrie[node].child != -1
+			&& commandTrie[commandTrie[node].child].sibling == -1 && len < size - 1) {
+		node = commandTrie[node].child;
+		rest[len++] = commandTrie[node].c;
+	}
+	rest[len] = '\0';
+	return commandTrie[start].count;
+}
+
+/**
+ * Prints the names below a trie node
+ *
+ * @param node - the node
+ */
+void printCommandNames(int node) {
+	for (; node != -1; node = commandTrie[node].sibling) {
+		if (commandTrie[node].command != -1) {
+			kprintf("%s  ", functionDefs[commandTrie[node].command].name);
 		}
+		printCommandNames(commandTrie[node].child);
 	}
-	return HELP_INVALID_ARGUMENTS; //return unkown command string
 }
+
+/**
+ * Prints every command name starting with a prefix, on one line
+ *
+ * @param prefix - the start of a name
+ */
+void printCompletions(const char *prefix) {
+	int node = findCommandPrefix(prefix);
+	if (node == -1) {
+		return;
+	}
+	if (commandTrie[node].command != -1) {
+		kprintf("%s  ", functionDefs[commandTrie[node].command].name);
+	}
+	printCommandNames(commandTrie[node].child);
+}
+
 /*******************************
  * Handle Com History
  *******************************/
@@ -135,39 +388,37 @@ void printStart() {
 }
 
 /**
- * Helper function to move the insertion point from the end of the line to the correct placement
+ * Helper function to send the echo for one keystroke. The output is formatted with
+ * kvsnprintf and handed to the serial driver in a single write.
  *
- * @param endIndex - index of last char printed
- * @param insertionIndex - index of where insertion point should be
+ * @param fmt - format of the output, as for ksnprintf
  */
-void returnToInsertionPoint(int endIndex, int insertionIndex) {
-	if (endIndex == NULL || insertionIndex == NULL){
-		return;
-	}
-
-	int i = 0;
-	for (; i < (endIndex - insertionIndex); i++) { //moves insertion point to the left to insertion point
-		serial_print("\b"); // \b moves insertion point back 1 space
+void editorWrite(const char *fmt, ...) {
+	char out[sizeof(buffer) + 16];
+	va_list args;
+	int len;
+
+	va_start(args, fmt);
+	len = kvsnprintf(out, sizeof(out), fmt, args);
+	va_end(args);
+	if (len > (int) sizeof(out) - 1) {
+		len = sizeof(out) - 1;
 	}
+	serial_write(out, len);
 }
 
 /**
- * Helper function to remove all printed chars on the current line of input back to the >>
+ * Helper function to replace the text on the current line of input after the >>.
+ * Moves back to the start of the input, erases to the end of the line and prints the new text.
  *
- * @param endIndex - index of last char printed
- * @param insertionIndex - index of where insertion point should be
+ * @param insertionIndex - index of where the insertion point is
+ * @param newText - the text to show
  */
-void eraseCurrentRow(int endIndex, int insertionIndex) {
-	if (endIndex == NULL || insertionIndex == NULL){
-		return;
-	}
-
-	int i = 0;
-	for (; i < (endIndex - insertionIndex); i++) { //moves insertion point right to end of line
-		serial_print("\033[C"); //char moves insertion point right 1 line
-	}
-	for (i = 0; i < endIndex; i++) { //backspaces all chars on the line
-		serial_print("\b \b"); //replaces char with space
+void replaceCurrentRow(int insertionIndex, const char *newText) {
+	if (insertionIndex > 0) {
+		editorWrite("\033[%dD\033[K%s", insertionIndex, newText); //cursor back, erase to end of line
+	} else {
+		editorWrite("\033[K%s", newText); //a count of 0 would still move one column
 	}
 }
 
@@ -176,7 +427,7 @@ void eraseCurrentRow(int endIndex, int insertionIndex) {
  *******************************/
 
 /**
- * Polls the input for characters and handles special key strokes such as delete, backspace, arrows, etc.
+ * Reads the input characters and handles special key strokes such as delete, backspace, arrows, etc.
  * and returns the input string
  *
  * @return string that was input
@@ -186,107 +437,121 @@ char *getInput() {
 	int endPos = 0;
 	int i = 0;
 	int continueInput = 1;
+	int matches;
+	char rest[sizeof(buffer)];
 	buffer[0] = '\0';
 
 	set_serial_in(COM1);
 	while (continueInput == 1) {
-		if (inb(COM1 + 5) & 1) { //check if there is a char input
-			char in = inb(COM1); //read char to in
-
-			switch (in) {
-				case 10: //carriage return /r
-					for (i = 0; i < insertPos; i++) { //moves insertion point to far left of line
-						serial_print("\033[D");
-					}
-					insertPos = 0;
+		char in = serial_getc(); //read char to in
+
+		switch (in) {
+			case 10: //carriage return /r
+				if (insertPos > 0) {
+					editorWrite("\033[%dD", insertPos); //moves insertion point to far left of line
+				}
+				insertPos = 0;
+				break;
+			case 13: //enter /n
+				continueInput = 0; //ends input loop
+
+				// Print a newline when enter is pressed
+				editorWrite("\n");
+				break;
+			case 27: //arrow key
+				serial_getc(); //useless bracket char
+				in = serial_getc(); //arrow key char
+				switch (in) {
+					case 'A': // up
+						strcpy(buffer, getComHistory(1)); //get previous command, copy into buffer
+						replaceCurrentRow(insertPos, buffer); //show it in place of the current row
+						endPos = strlen(buffer); //set endPos and insertPos to end of command
+						insertPos = endPos;
+						break;
+					case 'B': // down
+						strcpy(buffer, getComHistory(0)); //get next command, copy into buffer
+						replaceCurrentRow(insertPos, buffer); //show it in place of the current row
+						endPos = strlen(buffer); //set endPos and insertPos to length of buffer
+						insertPos = endPos;
+						break;
+					case 'C': // right
+						if (insertPos < endPos) { //cant move right if at end of line
+							insertPos++;
+							editorWrite("\033[C"); //print string to move right 1 position
+						}
+						break;
+					case 'D': //left
+						if (insertPos > 0) { //cant move left if at beginning
+							insertPos--;
+							editorWrite("\033[D"); //print string to move left 1 position
+						}
+						break;
+				}
+				break;
+			case 9: //tab, completes the command name
+				for (i = 0; i < endPos && buffer[i] != ' '; i++);
+				if (insertPos != endPos || i < endPos) { //only the name, and only at its end
 					break;
-				case 13: //enter /n
-					continueInput = 0; //ends input loop
-
-					// Print a newline when enter is pressed
-					serial_print("\n");
+				}
+				matches = completeCommand(buffer, rest, sizeof(buffer) - endPos - 1);
+				if (matches == 1 && endPos + strlen(rest) < (int) sizeof(buffer) - 1) {
+					strcat(rest, " "); //a whole name, ready for the arguments
+				}
+				if (rest[0] != '\0') {
+					strcat(buffer, rest);
+					endPos = insertPos = strlen(buffer);
+					editorWrite("%s", rest);
+				} else if (matches > 1) { //nothing in common left, show the choices
+					editorWrite("\n");
+					printCompletions(buffer);
+					printStart();
+					editorWrite("%s", buffer);
+				}
+				break;
+			case 127: //backspace
+				if (insertPos == 0) { //cant backspace
 					break;
-				case 27: //arrow key
-					inb(COM1); //useless bracket char
-					in = inb(COM1); //arrow key char
-					switch (in) {
-						case 'A': // up
-							eraseCurrentRow(endPos, insertPos); //erase current row
-							strcpy(buffer, getComHistory(1)); //get previous command, copy into buffer
-							endPos = strlen(buffer); //set endPos and insertPos to end of command
-							insertPos = endPos;
-							serial_print(buffer); //print buffer
-							break;
-						case 'B': // down
-							eraseCurrentRow(endPos, insertPos); //erase current row
-							strcpy(buffer, getComHistory(0)); //get next command, copy into buffer
-							endPos = strlen(buffer); //set endPos and insertPos to length of buffer
-							insertPos = endPos;
-							serial_print(buffer); //print buffer
-							break;
-						case 'C': // right
-							if (insertPos < endPos) { //cant move right if at end of line
-								insertPos++;
-								serial_print("\033[C"); //print string to move right 1 position
-							}
-							break;
-						case 'D': //left
-							if (insertPos > 0) { //cant move left if at beginning
-								insertPos--;
-								serial_print("\033[D"); //print string to move left 1 position
-							}
-							break;
-					}
+				}
+
+				for (i = insertPos - 1; i < endPos + 1; i++) { //shift chars to the left
+					buffer[i] = buffer[i + 1];
+				}
+
+				insertPos--;
+				endPos--;
+				editorWrite("\b\033[P"); //step back and delete the char; the terminal shifts the rest
+				break;
+			case 126: //delete
+				if (insertPos == endPos) { //cant delete at end of line
 					break;
-				case 127: //backspace
-					if (insertPos == 0) { //cant backspace
-						break;
-					}
-					eraseCurrentRow(endPos, insertPos); //clear row
+				}
 
-					for (i = insertPos - 1; i < endPos + 1; i++) { //shift chars to the left
-						buffer[i] = buffer[i + 1];
-					}
+				for (i = insertPos; i < endPos + 1; i++) { //shift everything left erasing deleted char
+					buffer[i] = buffer[i + 1];
+				}
+				endPos--;
+				editorWrite("\033[P"); //delete the char under the cursor; the terminal shifts the rest
+				break;
 
-					insertPos--;
-					endPos--;
-					serial_print(buffer); //print new buffer
-					returnToInsertionPoint(endPos, insertPos); //move insertion point to correct placement
+			default:
+				if (endPos == sizeof(buffer) - 1) { //buffer is full
 					break;
-				case 126: //delete
-					if (insertPos == endPos) { //cant delete at end of line
-						break;
-					}
-					eraseCurrentRow(endPos, insertPos); //clear row
-
-					for (i = insertPos; i < endPos + 1; i++) { //shift everything left erasing deleted char
-						buffer[i] = buffer[i + 1];
+				}
+				if (insertPos == endPos) { //insert to end
+					buffer[insertPos++] = in; //reads char into buffer
+					buffer[++endPos] = '\0'; //increment position and insert str end tag
+					editorWrite("%c", in); //print last char added to screen
+				} else {
+					for (i = endPos + 1; i > insertPos; i--) { //shift chars to the right one
+						buffer[i] = buffer[i - 1];
 					}
-					endPos--;
-					serial_print(buffer); //print new buffer
-					returnToInsertionPoint(endPos, insertPos); //return buffer to correct position
-					break;
 
-				default:
-					if (insertPos == endPos) { //insert to end
-						buffer[insertPos++] = in; //reads char into buffer
-						buffer[++endPos] = '\0'; //increment position and insert str end tag
-						serial_print(&buffer[insertPos - 1]); //print last char added to screen
-					} else {
-						eraseCurrentRow(endPos, insertPos); //clears current row
-
-						for (i = endPos + 1; i > insertPos; i--) { //shift chars to the right one
-							buffer[i] = buffer[i - 1];
-						}
-
-						buffer[insertPos] = in; //insert new char
-						serial_print(buffer); //print new buffer
-						endPos++;
-						insertPos++;
-						returnToInsertionPoint(endPos, insertPos); //returns insert point to correct position
-					}
-					break;
-			}
+					buffer[insertPos] = in; //insert new char
+					endPos++;
+					insertPos++;
+					editorWrite("\033[@%c", in); //open a blank at the cursor and write the char into it
+				}
+				break;
 		}
 	}
 	return buffer;
@@ -303,9 +568,14 @@ void executeCommand(char *commandString) {
 	}
 	char *comName = strtok(commandString, " "); //get first token which will be command name
 
-	functionDef funcDef;
-	funcDef = getFunctionDef(comName); //get functionDef associated with command
-	if (funcDef.funcPointer == NULL) { //check if was given blank functiondef, meaning no function for name
+	functionDef *funcDef = getFunctionDef(comName); //get functionDef associated with command, or the one it abbreviates
+	if (funcDef == NULL) { //no function for name
+		char rest[2];
+		if (completeCommand(comName, rest, sizeof(rest)) > 1) {
+			kprintf("\nAmbiguous Function Name: %s\n", comName);
+			printCompletions(comName);
+			return;
+		}
 		serial_print("\nInvalid Function Name: ");
 		serial_print(comName);
 		return;
@@ -324,7 +594,7 @@ void executeCommand(char *commandString) {
 		}
 	}
 
-	const char *respString = funcDef.funcPointer(arrOfArgs, count); //call functionPointer with args and count
+	const char *respString = funcDef->funcPointer(arrOfArgs, count); //call functionPointer with args and count
 	serial_println("");
 	serial_print(respString); //print response
 }
@@ -387,18 +657,16 @@ const char *shutdown(char **args, int numArgs) {
 	int getInp = 1;
 	set_serial_in(COM1); //set serial input port
 	while (getInp == 1) {
-		if (inb(COM1 + 5) & 1) { //check if there is a char input
-			char in = inb(COM1); //read char to in
-			buff[0] = in; //set buff
-
-			if (strcmp(buff, "y") == 0) { //if yes
-				continueHandle = 0; //quit input loop
-				return "shutting down";
-			} else if (strcmp(buff, "n") == 0) { //continue loop
-				return "not shutting down";
-			} else {
-				serial_println("\nInvalid input, please input (y/n)");
-			}
+		char in = serial_getc(); //read char to in
+		buff[0] = in; //set buff
+
+		if (strcmp(buff, "y") == 0) { //if yes
+			continueHandle = 0; //quit input loop
+			return "shutting down";
+		} else if (strcmp(buff, "n") == 0) { //continue loop
+			return "not shutting down";
+		} else {
+			serial_println("\nInvalid input, please input (y/n)");
 		}
 	}
 	return "Erroneous Exit";
@@ -415,6 +683,11 @@ void setupCommands() {
 	addFunctionDef("help", HELP_COMMAND_HELP, help); //adds help
 	addFunctionDef("shutdown", HELP_COMMAND_SHUTDOWN, shutdown); //adds shutdown
 	addFunctionDef("date", HELP_COMMAND_DATE, date); //adds date
+	addFunctionDef("serial", HELP_COMMAND_SERIAL, serial); //adds serial
+	addFunctionDef("dmesg", HELP_COMMAND_DMESG, dmesg); //adds dmesg
+	addFunctionDef("console", HELP_COMMAND_CONSOLE, console); //adds console
+	addFunctionDef("pci", HELP_COMMAND_PCI, pci); //adds pci
+	addFunctionDef("ktrace", HELP_COMMAND_KTRACE, ktrace); //adds ktrace
 
 	// registerR2TempCommands(); - No need for these any more.
 	registerR2PermCommands();
@@ -2,6 +2,12 @@
 #include <core/version.h>
 #include <core/help.h>
 #include <core/serial.h>
+#include <core/klog.h>
+#include <core/ktrace.h>
+#include <core/vga.h>
+#include <core/pci.h>
+#include <core/virtio.h>
+#include <printf.h>
 
 #include <time.h>
 #include <string.h>
@@ -9,6 +15,11 @@
 
 #include <modules/mpx_supt.h>
 
+// Throughput test written after a speed change: lines of this many bytes,
+// counting the line ending
+#define SERIAL_TEST_LINE 64
+#define SERIAL_TEST_LINES 16
+
 /**
  * Returns the current version of the OS.
  *
@@ -187,3 +198,348 @@ const char *date(char **args, int numArgs) {
 
 	return "";
 }
+
+/**
+ * Prints the serial device table, or changes the line speed of a port. After a switch a
+ * test pattern is written to the port and the measured throughput is printed.
+ *
+ * Usage: serial [--port n] [--baud n]
+ *
+ * Args:
+ * 	[no args] - Prints every port, its IRQ and line speed
+ * 	--port - The port to change, COMn; COM1 if not given
+ * 	--baud - Switches the port to speed n and prints the measured throughput
+ *
+ * @param args The arguments to pass to the function
+ * @param numArgs The number of arguments
+ * @return The result message
+ */
+const char *serial(char **args, int numArgs) {
+	char line[SERIAL_TEST_LINE + 1];
+	int number = 1, baud = 0;
+	serial_dev *dev;
+	unsigned long long start;
+	u32int ms;
+	int i;
+
+	for (i = 0; i < numArgs; i++) {
+		if (strcmp(args[i], "--baud") == 0 && i + 1 < numArgs) {
+			baud = atoi(args[++i]);
+		} else if (strcmp(args[i], "--port") == 0 && i + 1 < numArgs) {
+			number = atoi(args[++i]);
+		} else {
+			return HELP_INVALID_ARGUMENTS;
+		}
+	}
+
+	dev = serial_get_dev(number);
+	if (dev == NULL || !dev->present) {
+		return "No such serial port";
+	}
+
+	if (baud != 0) {
+		if (serial_set_baud(dev->port, baud) == SERIAL_BAD_BAUD) {
+			return "Unsupported speed. Speeds must divide 115200.";
+		}
+
+		// Time a fixed amount of output once it has all left the UART
+		for (i = 0; i < SERIAL_TEST_LINE - 2; i++) {
+			line[i] = 'A' + i % 26;
+		}
+		line[SERIAL_TEST_LINE - 2] = '\r';
+		line[SERIAL_TEST_LINE - 1] = '\n';
+		tsc_per_ms();
+		start = rdtsc64();
+		for (i = 0; i < SERIAL_TEST_LINES; i++) {
+			serial_write_device(dev->port, line, SERIAL_TEST_LINE);
+		}
+		serial_flush(dev->port);
+		// Slow speeds take longer than 32 bits of cycles; dropping the low
+		// bits keeps the division 32 bit
+		ms = (u32int) ((rdtsc64() - start) >> 8) / ((tsc_per_ms() >> 8) + 1);
+		if (ms == 0) {
+			ms = 1;
+		}
+
+		kprintf("COM%d: %d baud, measured throughput %u bytes/sec\n", number, baud,
+				SERIAL_TEST_LINE * SERIAL_TEST_LINES * 1000 / ms);
+		return "";
+	}
+
+	for (i = 1; (dev = serial_get_dev(i)) != NULL; i++) {
+		if (!dev->present) {
+			kprintf("COM%d: 0x%x IRQ%d not fitted\n", i, dev->port, dev->irq);
+			continue;
+		}
+		kprintf("COM%d: 0x%x IRQ%d %d baud, %u bytes dropped%s%s%s\n", i, dev->port, dev->irq,
+				dev->baud, dev->rx_dropped,
+				get_serial_out() == dev->port ? ", console" : "",
+				klog_get_device() == dev->port ? ", log" : "",
+				dev->irq_enabled ? "" : ", polled");
+	}
+
+	return "";
+}
+
+/**
+ * Private helper function to look up a level by name
+ *
+ * @param name The name
+ * @return The KLOG_* level, or -1 if there is none
+ */
+int _klogLevel(const char *name) {
+	int i;
+	for (i = 0; klog_level_name(i) != NULL; i++) {
+		if (strcmp(name, klog_level_name(i)) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/**
+ * Private helper function to look up a subsystem by name
+ *
+ * @param name The name
+ * @return The KLOG_* subsystem, or -1 if there is none
+ */
+int _klogSubsystem(const char *name) {
+	int i;
+	for (i = 0; klog_subsystem_name(i) != NULL; i++) {
+		if (strcmp(name, klog_subsystem_name(i)) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/**
+ * Replays the kernel log, or changes what each subsystem logs.
+ *
+ * Usage: dmesg [--level lvl] [--sub name] [--filter name lvl] [--filters] [--port n]
+ *
+ * Args:
+ * 	[no args] - Prints every record still in the log
+ * 	--level - Only prints records at level lvl or more severe
+ * 	--sub - Only prints records from subsystem name
+ * 	--filter - Makes subsystem name log only level lvl or more severe
+ * 	--filters - Prints each subsystem's level and the overrun count
+ * 	--port - Sends new records to COMn or virtio as they are logged, or to the console for 0; not the
+ *		port carrying the event trace
+ *
+ * @param args The arguments to pass to the function
+ * @param numArgs The number of arguments
+ * @return The result message
+ */
+const char *dmesg(char **args, int numArgs) {
+	int level = KLOG_LEVELS - 1, subsystem = -1, replay = 1;
+	int sub, lvl, i;
+	char num[12];
+
+	for (i = 0; i < numArgs; i++) {
+		if (strcmp(args[i], "--level") == 0 && i + 1 < numArgs) {
+			if ((level = _klogLevel(args[++i])) < 0) {
+				return HELP_INVALID_ARGUMENTS;
+			}
+		} else if (strcmp(args[i], "--sub") == 0 && i + 1 < numArgs) {
+			if ((subsystem = _klogSubsystem(args[++i])) < 0) {
+				return HELP_INVALID_ARGUMENTS;
+			}
+		} else if (strcmp(args[i], "--filter") == 0 && i + 2 < numArgs) {
+			sub = _klogSubsystem(args[++i]);
+			lvl = _klogLevel(args[++i]);
+			if (sub < 0 || lvl < 0) {
+				return HELP_INVALID_ARGUMENTS;
+			}
+			klog_set_filter(sub, lvl);
+			replay = 0;
+		} else if (strcmp(args[i], "--filters") == 0) {
+			replay = 0;
+		} else if (strcmp(args[i], "--port") == 0 && i + 1 < numArgs) {
+			lvl = serial_lookup(args[++i]);
+			if (lvl < 0) {
+				return "No such serial port";
+			}
+			if (lvl != 0 && lvl == ktrace_get_device() && ktraceMask != 0) {
+				return "That port carries the event trace";
+			}
+			klog_set_device(lvl);
+			replay = 0;
+		} else {
+			return HELP_INVALID_ARGUMENTS;
+		}
+	}
+
+	if (replay) {
+		klog_drain(); //print what is pending first so the replay is last
+		klog_replay(level, subsystem);
+		return "";
+	}
+
+	for (i = 0; klog_subsystem_name(i) != NULL; i++) {
+		serial_print(klog_subsystem_name(i));
+		serial_print(": ");
+		serial_println(klog_level_name(klog_get_filter(i)));
+	}
+	itoa((int) klog_overruns(), num, 10);
+	serial_print("Overruns: ");
+	serial_println(num);
+
+	return "";
+}
+
+/**
+ * Chooses where console output goes: the serial port, the VGA screen, or both.
+ * Input always comes from the serial port.
+ *
+ * Usage: console [--serial] [--vga] [--both]
+ *
+ * Args:
+ * 	[no args] - Prints where output goes
+ * 	--serial - Writes output to COM1 only
+ * 	--vga - Writes output to the screen only
+ * 	--both - Writes output to COM1 and the screen
+ *
+ * @param args The arguments to pass to the function
+ * @param numArgs The number of arguments
+ * @return The result message
+ */
+const char *console(char **args, int numArgs) {
+	if (numArgs == 1 && strcmp(args[0], "--serial") == 0) {
+		set_serial_out(COM1);
+		set_serial_mirror(0);
+	} else if (numArgs == 1 && strcmp(args[0], "--vga") == 0) {
+		set_serial_out(VGA);
+		set_serial_mirror(0);
+	} else if (numArgs == 1 && strcmp(args[0], "--both") == 0) {
+		set_serial_out(COM1);
+		set_serial_mirror(VGA);
+	} else if (numArgs != 0) {
+		return HELP_INVALID_ARGUMENTS;
+	}
+
+	if (get_serial_mirror() != 0) {
+		return "Console output: serial and vga";
+	}
+	return get_serial_out() == VGA ? "Console output: vga" : "Console output: serial";
+}
+
+/**
+ * Lists the PCI functions found at boot and whether the virtio console
+ * is carrying output.
+ *
+ * Usage: pci
+ *
+ * @param args The arguments to pass to the function
+ * @param numArgs The number of arguments
+ * @return The result message
+ */
+const char *pci(char **args, int numArgs) {
+	pci_device *dev;
+	int i, j;
+	(void) args;
+
+	if (numArgs != 0) {
+		return HELP_INVALID_ARGUMENTS;
+	}
+
+	for (i = 0; (dev = pci_get(i)) != NULL; i++) {
+		kprintf("%02x:%02x.%d %04x:%04x class %02x.%02x IRQ%d", dev->bus, dev->slot, dev->func,
+				dev->vendor, dev->device, dev->classCode, dev->subclass, dev->irq);
+		for (j = 0; j < 6; j++) {
+			if (dev->bar[j] & PCI_BAR_IO) {
+				kprintf(" io 0x%x", dev->bar[j] & ~0x3);
+			}
+		}
+		kprintf("\n");
+	}
+	if (i == 0) {
+		return "No PCI devices found";
+	}
+	if (virtio_console_ready()) {
+		kprintf("virtio console: %u bytes sent\n", virtio_console_sent());
+	}
+	return "";
+}
+
+/**
+ * Turns a comma separated list of event classes into a mask.
+ *
+ * @param list The list
+ * @return The KTRACE_* mask, or 0 if a class is not known
+ */
+u32int ktrace_classes(const char *list) {
+	static const char *names[] = {"sched", "heap", "irq", "all"};
+	static const u32int classes[] = {KTRACE_SCHED, KTRACE_HEAP, KTRACE_IRQ, KTRACE_ALL};
+	char name[8];
+	u32int mask = 0;
+	int i, c;
+
+	while (*list != '\0') {
+		for (i = 0; i < 7 && *list != '\0' && *list != ','; i++)
+			name[i] = *list++;
+		name[i] = '\0';
+		if (*list == ',')
+			list++;
+		for (c = 0; c < 4 && strcmp(name, names[c]) != 0; c++);
+		if (c == 4)
+			return 0;
+		mask |= classes[c];
+	}
+	return mask;
+}
+
+/**
+ * Controls the binary event trace: which port carries it and which
+ * classes of events are sent. tools/ktracedump decodes the stream.
+ *
+ * Usage: ktrace [--port n] [--on classes] [--off]
+ *
+ * Args:
+ * 	[no args] - Prints the port, the classes traced, bytes sent and events lost
+ * 	--port - Sends the trace to COMn or virtio; not a port carrying the console, log or heap trace
+ * 	--on - Traces the classes, a comma separated list of sched, heap, irq or all
+ * 	--off - Stops tracing
+ *
+ * @param args The arguments to pass to the function
+ * @param numArgs The number of arguments
+ * @return The result message
+ */
+const char *ktrace(char **args, int numArgs) {
+	u32int mask = ktraceMask;
+	int device, i;
+
+	for (i = 0; i < numArgs; i++) {
+		if (strcmp(args[i], "--port") == 0 && i + 1 < numArgs) {
+			device = serial_lookup(args[++i]);
+			if (!ktrace_port_ok(device)) {
+				return "No such serial port, or it carries the console, log or heap trace";
+			}
+			ktrace_set_device(device);
+		} else if (strcmp(args[i], "--on") == 0 && i + 1 < numArgs) {
+			if ((mask = ktrace_classes(args[++i])) == 0) {
+				return HELP_INVALID_ARGUMENTS;
+			}
+		} else if (strcmp(args[i], "--off") == 0) {
+			mask = 0;
+		} else {
+			return HELP_INVALID_ARGUMENTS;
+		}
+	}
+
+	if (mask != 0 && ktrace_get_device() == 0) {
+		return "Choose a port with --port first";
+	}
+	if (mask != 0 && !ktrace_port_ok(ktrace_get_device())) {
+		return "The trace port now carries the console, log or heap trace; choose another";
+	}
+	ktrace_set_mask(mask);
+
+	kprintf("port 0x%x, classes%s%s%s%s, %u bytes sent, %u events lost\n", ktrace_get_device(),
+			ktraceMask == 0 ? " none" : "",
+			ktrace_on(KTRACE_SCHED) ? " sched" : "",
+			ktrace_on(KTRACE_HEAP) ? " heap" : "",
+			ktrace_on(KTRACE_IRQ) ? " irq" : "",
+			ktrace_sent(), ktrace_lost());
+	return "";
+}
@@ -11,6 +11,8 @@
 #include <core/serial.h>
 #include <core/tables.h>
 #include <core/interrupts.h>
+#include <mem/paging.h>
+#include <mem/stack.h>
 
 // Programmable Interrupt Controllers
 #define PIC1 0x20
@@ -64,21 +66,13 @@ extern void rtc_isr();
 
 extern void sys_call_isr();
 
-extern idt_entry idt_entries[256];
-
-//Current serial handler
-extern void isr0();
+extern u32int pic_irqs[16];
 
-void do_isr() {
-	char in = inb(COM2);
-	serial_print(&in);
-	serial_println("here");
-	outb(0x20, 0x20); //EOI
-}
+extern idt_entry idt_entries[256];
 
 /**
- * Installs the initial interrupt handlers for the first 32 irq lines.
- * Most do a panic for now.
+ * Installs the initial interrupt handlers for the first 32 irq lines,
+ * most of which panic for now, and a default handler on every PIC vector.
  */
 void init_irq(void) {
 	int i;
@@ -109,8 +103,17 @@ void init_irq(void) {
 		if (i < 17) idt_set_gate(i, isrs[i], 0x08, 0x8e);
 		else idt_set_gate(i, (u32int) reserved, 0x08, 0x8e);
 	}
-	// Ignore interrupts from the real time clock
-	idt_set_gate(0x08, (u32int) rtc_isr, 0x08, 0x8e);
+	// IRQs are remapped off the exception vectors by init_pic, so the
+	// double fault vector no longer needs to absorb the timer
+
+	// Page faults switch to their own task through a task gate, so a
+	// fault on the current stack still has a stack to run on
+	idt_set_gate(14, 0, GDT_FAULT_TSS_ID << 3, 0x85);
+
+	// Every PIC vector gets a default handler; drivers replace their own
+	// line's gate. Spurious IRQ7 and IRQ15 arrive even while masked.
+	for (i = 0; i < 16; i++)
+		idt_set_gate(PIC_VECTOR_BASE + i, pic_irqs[i], 0x08, 0x8e);
 
 	// Install the context-switching interrupt
 	// Need to register this under 0x3C since the interrupts are called
@@ -142,6 +145,60 @@ void init_pic(void) {
 	outb(PIC1 + 1, 0xFF); //disable irqs for PIC1
 	io_wait();
 	outb(PIC2 + 1, 0xFF); //disable irqs for PIC2
+	io_wait();
+	pic_unmask(2);        //cascade line, so PIC2 irqs can be unmasked
+}
+
+/**
+ * Lets an IRQ line through the PIC.
+ *
+ * @param irq The IRQ line, 0-15
+ */
+void pic_unmask(int irq) {
+	int port = irq < 8 ? PIC1 + 1 : PIC2 + 1;
+	u8int mask = inb(port);
+	outb(port, mask & ~(1 << (irq % 8)));
+}
+
+/**
+ * Acknowledges an IRQ so the PIC delivers the next one.
+ *
+ * @param irq The IRQ line, 0-15
+ */
+void pic_eoi(int irq) {
+	if (irq >= 8) outb(PIC2, 0x20);
+	outb(PIC1, 0x20);
+}
+
+/**
+ * Reads a PIC's in-service register.
+ *
+ * @param pic PIC1 or PIC2
+ * @return The lines being serviced, one bit each
+ */
+static u8int pic_isr(int pic) {
+	outb(pic, 0x0B); //ocw3: read the ISR on the next read
+	return inb(pic);
+}
+
+/**
+ * Default handler for an IRQ no driver has claimed. A spurious IRQ7 or
+ * IRQ15, raised when a line drops before the CPU acknowledges it, is not
+ * in service and must not be acknowledged, though the master still needs
+ * the EOI for the cascade line in the IRQ15 case. Anything else is
+ * acknowledged and dropped.
+ *
+ * @param irq The IRQ line, 0-15
+ */
+void do_pic_irq(int irq) {
+	if (irq == 7 && !(pic_isr(PIC1) & 0x80)) {
+		return;
+	}
+	if (irq == 15 && !(pic_isr(PIC2) & 0x80)) {
+		outb(PIC1, 0x20);
+		return;
+	}
+	pic_eoi(irq);
 }
 
 void do_divide_error() {
@@ -200,8 +257,29 @@ void do_general_protection() {
 	kpanic("General protection fault");
 }
 
-void do_page_fault() {
-	kpanic("Page Fault");
+/**
+ * Page fault handler. Faults in demand-zero regions are resolved by
+ * mapping a frame. A fault in a stack's guard is an overflow; anything
+ * else is a wild access. Both panic.
+ *
+ * @param addr The faulting address, from CR2
+ * @param error The error code pushed by the CPU
+ */
+void do_page_fault(u32int addr, u32int error) {
+	char msg[] = "Page Fault at 0x00000000, error 0";
+	int i;
+
+	if (handle_page_fault(addr, error))
+		return;
+	if (stack_overflowed(addr))
+		kpanic("Stack overflow");
+
+	for (i = 0; i < 8; i++) {
+		u32int digit = (addr >> (28 - 4 * i)) & 0xF;
+		msg[16 + i] = digit < 10 ? '0' + digit : 'a' + digit - 10;
+	}
+	msg[32] = '0' + (error & 0x7);
+	kpanic(msg);
 }
 
 void do_reserved() {
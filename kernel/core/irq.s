@@ -25,6 +25,9 @@
 [GLOBAL coprocessor]
 [GLOBAL rtc_isr]
 [GLOBAL sys_call_isr]
+[GLOBAL serial_irq3]
+[GLOBAL serial_irq4]
+[GLOBAL pic_irqs]
 
 ;; Names of the C handlers
 extern do_divide_error
@@ -45,6 +48,8 @@ extern do_page_fault
 extern do_reserved
 extern do_coprocessor
 extern sys_call
+extern do_serial_irq
+extern do_pic_irq
 
 ; RTC interrupt handler
 ; Tells the slave PIC to ignore
@@ -106,9 +111,19 @@ stack_segment:
 general_protection:
 	call do_general_protection
 	iret
+;;; Page fault task. Entered through a task gate, so it runs on its
+;;; own stack with the error code on top, even when the fault was on
+;;; the interrupted stack. Passes the faulting address from cr2 and
+;;; the error code to the C handler. iret switches back to the faulting
+;;; task, which retries the access; the next fault resumes at the jmp.
 page_fault:
+	mov eax, cr2
+	push dword [esp]	; error code
+	push eax
 	call do_page_fault
+	add esp, 12		; arguments and error code
 	iret
+	jmp page_fault
 reserved:
 	call do_reserved
 	iret
@@ -116,6 +131,60 @@ coprocessor:
 	call do_coprocessor
 	iret
 
+;;; Serial port interrupts. Pass the IRQ line to the C handler,
+;;; which services every device on it and sends the EOI.
+serial_irq3:
+	pusha
+	push dword 3
+	call do_serial_irq
+	add esp, 4
+	popa
+	iret
+serial_irq4:
+	pusha
+	push dword 4
+	call do_serial_irq
+	add esp, 4
+	popa
+	iret
+
+;;; Default IRQ handlers, one per PIC line. init_irq installs
+;;; them on every remapped vector so an IRQ nothing has claimed,
+;;; including a spurious IRQ7 or IRQ15, never finds an empty gate.
+%macro PIC_IRQ 1
+pic_irq%1:
+	pusha
+	push dword %1
+	call do_pic_irq
+	add esp, 4
+	popa
+	iret
+%endmacro
+
+PIC_IRQ 0
+PIC_IRQ 1
+PIC_IRQ 2
+PIC_IRQ 3
+PIC_IRQ 4
+PIC_IRQ 5
+PIC_IRQ 6
+PIC_IRQ 7
+PIC_IRQ 8
+PIC_IRQ 9
+PIC_IRQ 10
+PIC_IRQ 11
+PIC_IRQ 12
+PIC_IRQ 13
+PIC_IRQ 14
+PIC_IRQ 15
+
+;;; Table of the handlers above, indexed by IRQ line
+pic_irqs:
+	dd pic_irq0, pic_irq1, pic_irq2, pic_irq3
+	dd pic_irq4, pic_irq5, pic_irq6, pic_irq7
+	dd pic_irq8, pic_irq9, pic_irq10, pic_irq11
+	dd pic_irq12, pic_irq13, pic_irq14, pic_irq15
+
 ;;; System call interrupt handler. Pushes all the x86 registers
 ;;; onto the stack followed by ds,es,fs,gs (see context structure).
 ;;; Pushes esp last, which the function can cast to a context and
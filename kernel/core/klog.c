@@ -0,0 +1,273 @@
+/*
+  ----- klog.c -----
+
+  Description..: Kernel log. Messages go into a ring of fixed-size
+	  records and are printed later, so logging never waits on the
+	  serial port. Producers claim a record with a locked add and
+	  may run in interrupt handlers; only the drain prints.
+*/
+
+#include <string.h>
+#include <system.h>
+#include <printf.h>
+
+#include <core/klog.h>
+#include <core/serial.h>
+
+static klog_record ring[KLOG_RECORDS];
+static volatile u32int head = 0;     //next sequence number handed out
+static volatile u32int tail = 0;     //next sequence number to print
+static volatile u32int overruns = 0;
+static volatile int draining = 0;
+static int device = 0; //0 for the console
+
+static int filters[KLOG_SUBSYSTEMS] = {KLOG_INFO, KLOG_INFO, KLOG_INFO, KLOG_INFO};
+
+static const char *levelNames[KLOG_LEVELS] = {"err", "warn", "info", "debug"};
+static const char *subsystemNames[KLOG_SUBSYSTEMS] = {"core", "mem", "serial", "proc"};
+
+/**
+ * Adds to a counter atomically.
+ *
+ * @param p The counter
+ * @param v The amount to add
+ * @return The value before the add
+ */
+static inline u32int fetch_add(volatile u32int *p, u32int v) {
+	asm volatile ("lock xaddl %0, %1"
+	: "+r"(v), "+m"(*p)
+	:
+	: "memory");
+	return v;
+}
+
+/**
+ * Sets a flag atomically.
+ *
+ * @param p The flag
+ * @return The value before it was set
+ */
+static inline int test_and_set(volatile int *p) {
+	int v = 1;
+	asm volatile ("xchgl %0, %1"
+	: "+r"(v), "+m"(*p)
+	:
+	: "memory");
+	return v;
+}
+
+/**
+ * Logs a message. Never blocks: the message is copied into the ring and
+ * printed later by klog_drain. If the oldest record has not been printed
+ * yet it is overwritten and counted as an overrun.
+ *
+ * @param subsystem The KLOG_* subsystem
+ * @param level The KLOG_* level
+ * @param msg The message
+ */
+void klog(int subsystem, int level, const char *msg) {
+	klog_record *rec;
+	u32int seq;
+	int i;
+
+	if (subsystem < 0 || subsystem >= KLOG_SUBSYSTEMS || level > filters[subsystem])
+		return;
+
+	seq = fetch_add(&head, 1);
+	if (seq - tail >= KLOG_RECORDS)
+		fetch_add(&overruns, 1);
+
+	rec = &ring[seq & (KLOG_RECORDS - 1)];
+	rec->seq = KLOG_BUSY;
+	asm volatile ("" ::: "memory");
+	for (i = 0; i < KLOG_MSG_SIZE - 1 && msg[i] != '\0'; i++)
+		rec->msg[i] = msg[i];
+	rec->msg[i] = '\0';
+	rec->level = level;
+	rec->subsystem = subsystem;
+	asm volatile ("" ::: "memory");
+	rec->seq = seq + 1;
+}
+
+/**
+ * Copies a record out of the ring if it is complete and still holds the
+ * given sequence number.
+ *
+ * @param seq The sequence number
+ * @param out Where to copy the record
+ * @return True if the copy is good
+ */
+int klog_read(u32int seq, klog_record *out) {
+	klog_record *rec = &ring[seq & (KLOG_RECORDS - 1)];
+	u32int stamp = rec->seq;
+	int i;
+
+	if (stamp != seq + 1)
+		return 0;
+	asm volatile ("" ::: "memory");
+	for (i = 0; i < KLOG_MSG_SIZE; i++)
+		out->msg[i] = rec->msg[i];
+	out->msg[KLOG_MSG_SIZE - 1] = '\0';
+	out->level = rec->level;
+	out->subsystem = rec->subsystem;
+	out->seq = stamp;
+	asm volatile ("" ::: "memory");
+	//a producer may have reused the record while it was copied
+	return rec->seq == stamp;
+}
+
+/**
+ * Prints one record as a single write.
+ *
+ * @param rec The record
+ * @param dev The device, or 0 for the console
+ * @param prefix Text put in front of the record
+ */
+void klog_print(klog_record *rec, int dev, const char *prefix) {
+	char line[KLOG_MSG_SIZE + 32];
+	int len = ksnprintf(line, sizeof(line), "%s%s/%s: %s\r\n", prefix,
+			levelNames[rec->level], subsystemNames[rec->subsystem], rec->msg);
+
+	if (len > (int) sizeof(line) - 1)
+		len = sizeof(line) - 1;
+	if (dev == 0)
+		serial_write(line, len);
+	else
+		serial_write_device(dev, line, len);
+}
+
+/**
+ * Prints every record logged since the last drain to the active serial
+ * device. Does nothing if a drain is already running.
+ */
+void klog_drain() {
+	klog_record rec;
+	u32int stamp;
+
+	if (test_and_set(&draining))
+		return;
+
+	while (tail != head) {
+		//records that were overwritten were counted by their producer
+		if (head - tail > KLOG_RECORDS)
+			tail = head - KLOG_RECORDS;
+
+		if (klog_read(tail, &rec)) {
+			klog_print(&rec, device, "");
+		} else {
+			//stop at a record that is still being written; skip one
+			//a later producer has already taken over
+			stamp = ring[tail & (KLOG_RECORDS - 1)].seq;
+			if (stamp == KLOG_BUSY || (int) (stamp - (tail + 1)) <= 0)
+				break;
+		}
+		tail++;
+	}
+
+	draining = 0;
+}
+
+/**
+ * Sends the drained log to its own device instead of the console.
+ *
+ * @param dev The device, or 0 for the console
+ */
+void klog_set_device(int dev) {
+	device = dev;
+}
+
+/**
+ * Gets the device the drained log is sent to.
+ *
+ * @return The device, or 0 for the console
+ */
+int klog_get_device() {
+	return device;
+}
+
+/**
+ * Tests if there are records the drain has not printed yet.
+ *
+ * @return True if there is something to drain
+ */
+int klog_pending() {
+	return tail != head;
+}
+
+/**
+ * Sets the least severe level stored for a subsystem.
+ *
+ * @param subsystem The KLOG_* subsystem
+ * @param level The KLOG_* level
+ */
+void klog_set_filter(int subsystem, int level) {
+	if (subsystem >= 0 && subsystem < KLOG_SUBSYSTEMS && level >= 0 && level < KLOG_LEVELS)
+		filters[subsystem] = level;
+}
+
+/**
+ * Gets the least severe level stored for a subsystem.
+ *
+ * @param subsystem The KLOG_* subsystem
+ * @return The KLOG_* level
+ */
+int klog_get_filter(int subsystem) {
+	if (subsystem < 0 || subsystem >= KLOG_SUBSYSTEMS)
+		return -1;
+	return filters[subsystem];
+}
+
+/**
+ * Prints the records still in the ring, oldest first.
+ *
+ * @param level Only records at or above this level are printed
+ * @param subsystem Only records from this subsystem are printed, or -1 for all
+ */
+void klog_replay(int level, int subsystem) {
+	klog_record rec;
+	char num[16];
+	u32int end = head;
+	u32int seq = end > KLOG_RECORDS ? end - KLOG_RECORDS : 0;
+
+	for (; seq != end; seq++) {
+		if (!klog_read(seq, &rec) || rec.level > level)
+			continue;
+		if (subsystem >= 0 && rec.subsystem != subsystem)
+			continue;
+		ksnprintf(num, sizeof(num), "[%u] ", seq);
+		klog_print(&rec, 0, num);
+	}
+}
+
+/**
+ * Gets the number of records overwritten before they were printed.
+ *
+ * @return The number of overruns
+ */
+u32int klog_overruns() {
+	return overruns;
+}
+
+/**
+ * Gets the name of a level.
+ *
+ * @param level The KLOG_* level
+ * @return The name, or NULL if there is no such level
+ */
+const char *klog_level_name(int level) {
+	if (level < 0 || level >= KLOG_LEVELS)
+		return NULL;
+	return levelNames[level];
+}
+
+/**
+ * Gets the name of a subsystem.
+ *
+ * @param subsystem The KLOG_* subsystem
+ * @return The name, or NULL if there is no such subsystem
+ */
+const char *klog_subsystem_name(int subsystem) {
+	if (subsystem < 0 || subsystem >= KLOG_SUBSYSTEMS)
+		return NULL;
+	return subsystemNames[subsystem];
+}
@@ -16,53 +16,288 @@
 #include <core/interrupts.h>
 #include <core/queue.h>
 #include <core/comHandler.h>
+#include <core/multiboot.h>
+#include <core/vga.h>
+#include <core/klog.h>
+#include <core/ktrace.h>
+#include <core/pci.h>
+#include <core/virtio.h>
 #include <mem/heap.h>
+#include <mem/heapProfile.h>
 #include <mem/paging.h>
 #include <mem/memoryControl.h>
+#include <mem/stack.h>
 #include <modules/mpx_supt.h>
 
+static char bootCmdline[256]; //copy of the boot command line
+static int bootCmdlineRead = 0;
+
+/**
+ * Logs how long a boot stage took, in thousands of CPU cycles.
+ *
+ * @param stage The name of the stage
+ * @param start The rdtsc value taken when the stage began
+ */
+void log_stage_time(const char *stage, u32int start) {
+	char msg[64], cycles[11];
+
+	itoa((int) ((rdtsc() - start) / 1000), cycles, 10);
+	strcpy(msg, stage);
+	strcat(msg, " took ");
+	strcat(msg, cycles);
+	strcat(msg, "K cycles");
+	klogv(msg);
+}
+
+/**
+ * Finds an option in the boot command line, given as key=value. The
+ * command line is copied on the first call, which has to come before
+ * paging is turned on; later calls read the copy.
+ *
+ * @param info The multiboot information from the boot loader
+ * @param key The option name, including the =
+ * @return The start of the value, or NULL if the option was not given
+ */
+const char *boot_option(multiboot_info *info, const char *key) {
+	const char *cmdline;
+	int i;
+
+	if (!bootCmdlineRead) {
+		bootCmdlineRead = 1;
+		if ((info->flags & MULTIBOOT_FLAG_CMDLINE) && info->cmdline != 0) {
+			cmdline = (const char *) info->cmdline;
+			for (i = 0; i < (int) sizeof(bootCmdline) - 1 && cmdline[i] != '\0'; i++)
+				bootCmdline[i] = cmdline[i];
+			bootCmdline[i] = '\0';
+		}
+	}
+
+	for (cmdline = bootCmdline; *cmdline != '\0'; cmdline++) {
+		//only at the start of a word, so trace= does not match ktrace=
+		if (cmdline != bootCmdline && cmdline[-1] != ' ')
+			continue;
+		for (i = 0; key[i] != '\0' && cmdline[i] == key[i]; i++);
+		if (key[i] == '\0')
+			return cmdline + i;
+	}
+	return NULL;
+}
+
+/**
+ * Finds the console line speed in the boot command line, given as
+ * baud=n.
+ *
+ * @param info The multiboot information from the boot loader
+ * @return The requested speed, or SERIAL_DEFAULT_BAUD if none was given
+ */
+int boot_baud(multiboot_info *info) {
+	const char *value = boot_option(info, "baud=");
+	return value == NULL ? SERIAL_DEFAULT_BAUD : atoi(value);
+}
+
+/**
+ * Picks the output devices from the boot command line: console=vga
+ * writes to the screen only, console=both writes to COM1 and mirrors to
+ * the screen. Anything else leaves output on COM1.
+ *
+ * @param info The multiboot information from the boot loader
+ */
+void boot_console(multiboot_info *info) {
+	if (boot_option(info, "console=vga") != NULL) {
+		set_serial_out(VGA);
+	} else if (boot_option(info, "console=both") != NULL) {
+		set_serial_mirror(VGA);
+	}
+}
+
+/**
+ * Brings up the serial ports other than the console. Each port that
+ * answers the probe gets the default line speed. log=n and trace=n on
+ * the boot command line send the kernel log or heap trace to COMn.
+ *
+ * @param info The multiboot information from the boot loader, or NULL
+ */
+void boot_ports(multiboot_info *info) {
+	const char *value;
+	int number;
+
+	for (number = 2; number <= SERIAL_PORTS; number++) {
+		if (serial_probe(serial_port(number))) {
+			init_serial(serial_port(number), SERIAL_DEFAULT_BAUD);
+		}
+	}
+	if (info == NULL)
+		return;
+
+	if ((value = boot_option(info, "log=")) != NULL) {
+		number = atoi(value);
+		if (serial_get_dev(number) != NULL && serial_get_dev(number)->present)
+			klog_set_device(serial_port(number));
+	}
+	if ((value = boot_option(info, "trace=")) != NULL) {
+		number = atoi(value);
+		if (serial_get_dev(number) != NULL && serial_get_dev(number)->present)
+			setTraceDevice(serial_port(number));
+	}
+}
+
+/**
+ * Finds the PCI devices and brings up the virtio console if there is
+ * one. log=virtio and trace=virtio on the boot command line send the
+ * kernel log or heap trace to it, and console=virtio mirrors the console
+ * to it. Without a virtio console these stay on the serial port.
+ *
+ * @param info The multiboot information from the boot loader, or NULL
+ */
+void boot_virtio(multiboot_info *info) {
+	char msg[40];
+
+	strcpy(msg, "PCI functions found: ");
+	itoa(pci_enumerate(), msg + strlen(msg), 10);
+	klogv(msg);
+	if (!virtio_console_init() || info == NULL)
+		return;
+
+	if (boot_option(info, "log=virtio") != NULL)
+		klog_set_device(VIRTIO_CON);
+	if (boot_option(info, "trace=virtio") != NULL)
+		setTraceDevice(VIRTIO_CON);
+	if (boot_option(info, "console=virtio") != NULL)
+		set_serial_mirror(VIRTIO_CON);
+}
+
+/**
+ * Starts the binary event trace if the boot command line has ktrace=n,
+ * where n names a port as serial_lookup takes it. Every class of event is
+ * traced. The console port cannot carry the trace.
+ *
+ * @param info The multiboot information from the boot loader, or NULL
+ */
+void boot_ktrace(multiboot_info *info) {
+	const char *value;
+	char name[8];
+	int device, i;
+
+	if (info == NULL || (value = boot_option(info, "ktrace=")) == NULL)
+		return;
+
+	for (i = 0; i < 7 && value[i] != '\0' && value[i] != ' '; i++)
+		name[i] = value[i];
+	name[i] = '\0';
+	device = serial_lookup(name);
+	if (!ktrace_port_ok(device)) {
+		klog(KLOG_CORE, KLOG_WARN, "ktrace= needs a port not carrying the console, log or heap trace");
+		return;
+	}
+	ktrace_set_device(device);
+	ktrace_set_mask(KTRACE_ALL);
+}
+
 void kmain(void) {
 	extern uint32_t magic;
-	// Uncomment if you want to access the multiboot header
-	// extern void *mbd;
-	// char *boot_loader_name = (char*)((long*)mbd)[16];
-
-	// Set up the heap.
-	initializeHeap(500000);
-	sys_set_malloc(allocateMemory);
-	sys_set_free(deallocateMemory);
+	extern void *mbd;
+	u32int stage_start;
+	char mem_kb[11], msg[64];
+	int baud = SERIAL_DEFAULT_BAUD, bad_baud = 0, baud_ok = 1;
+	int i;
 
 	// 0) Initialize Serial I/O and call mpx_init
-	init_serial(COM1);
+	if (magic == MULTIBOOT_BOOT_MAGIC) {
+		baud = boot_baud((multiboot_info *) mbd);
+	}
+	if (init_serial(COM1, baud) == SERIAL_BAD_BAUD) {
+		bad_baud = baud;
+		baud_ok = 0;
+		baud = SERIAL_DEFAULT_BAUD;
+		init_serial(COM1, baud);
+	}
+	serial_probe(COM1);
 	set_serial_in(COM1);
 	set_serial_out(COM1);
+	boot_ports(magic == MULTIBOOT_BOOT_MAGIC ? (multiboot_info *) mbd : NULL);
+	vga_init();
+	if (magic == MULTIBOOT_BOOT_MAGIC) {
+		boot_console((multiboot_info *) mbd);
+	}
 	mpx_init(MODULE_R5);
 
 	klogv("Starting MPX boot sequence...");
-	klogv("Initialized serial I/O on COM1 device...");
+	if (!baud_ok) {
+		itoa(bad_baud, mem_kb, 10);
+		strcpy(msg, "Unsupported baud=");
+		strcat(msg, mem_kb);
+		strcat(msg, ", using the default");
+		klogv(msg);
+	}
+	itoa(baud, mem_kb, 10);
+	strcpy(msg, "Initialized serial I/O on COM1 device at ");
+	strcat(msg, mem_kb);
+	strcat(msg, " baud...");
+	klogv(msg);
 
 	// 1) Check that the boot was successful and correct when using grub
 	// Comment this when booting the kernel directly using QEMU, etc.
-	if (magic != 0x2BADB002) {
+	if (magic != MULTIBOOT_BOOT_MAGIC) {
 		//kpanic("Boot was not error free. Halting.");
 	}
 
 	// 2) Descriptor Tables
 	klogv("Initializing descriptor tables...");
+	stage_start = rdtsc();
 	init_idt();      // Initialize the interrupt descriptor table
 	init_gdt();      // Initialize the global descriptor table
 	init_irq();      // Initialize the interrupt handlers
+	init_pic();      // Remap IRQs off the exception vectors; all masked
+	for (i = 1; i <= SERIAL_PORTS; i++) { // Interrupt-driven ports
+		if (serial_get_dev(i)->present) {
+			serial_enable_irq(serial_port(i));
+		}
+	}
 	sti();           // Enable interrupts
+	log_stage_time("Descriptor tables", stage_start);
 
 	// 4) Virtual Memory
 	klogv("Initializing virtual memory...");
+	stage_start = rdtsc();
+	if (magic == MULTIBOOT_BOOT_MAGIC) {
+		detect_memory((multiboot_info *) mbd);
+	}
 	init_paging();
+	if (!init_stacks()) {
+		kpanic("Could not register the process stack region.");
+	}
+	itoa((int) (get_free_frames() * (PAGE_SIZE / 1024)), mem_kb, 10);
+	strcpy(msg, "Free physical memory: ");
+	strcat(msg, mem_kb);
+	strcat(msg, " KB");
+	klogv(msg);
+	log_stage_time("Virtual memory", stage_start);
+
+	// Set up the heap. It maps its frames through the kernel page
+	// directory, so this has to come after paging is enabled.
+	klogv("Initializing heap...");
+	stage_start = rdtsc();
+	if (!initializeHeap(500000)) {
+		kpanic("Could not initialize the heap.");
+	}
+	log_stage_time("Heap", stage_start);
+	sys_set_malloc(allocateMemory);
+	sys_set_free(deallocateMemory);
+
+	// Find the PCI devices. The virtio console's queues live in the
+	// identity-mapped kernel image, so this comes after paging too.
+	klogv("Scanning the PCI bus...");
+	boot_virtio(magic == MULTIBOOT_BOOT_MAGIC ? (multiboot_info *) mbd : NULL);
+	boot_ktrace(magic == MULTIBOOT_BOOT_MAGIC ? (multiboot_info *) mbd : NULL);
 
 	// 5) Call Commhand
 	klogv("Transferring control to commhand...");
 
 	// Create the process for the command handler
 	pcb *commHand = setupPCB("CommandHandler", 1, 1);
+	if (commHand == NULL) {
+		kpanic("Could not allocate the CommandHandler process.");
+	}
 	context *commHandCp = (context *)(commHand->stackTop);
 	memset(commHandCp, 0, sizeof(struct context));
 	commHandCp->fs = 0x10;
@@ -77,6 +312,9 @@ void kmain(void) {
 
 	// Create the process for the idle process
 	pcb *idleProc = setupPCB("Idle", 0, 0);
+	if (idleProc == NULL) {
+		kpanic("Could not allocate the Idle process.");
+	}
 	context *idleCp = (context *)(idleProc->stackTop);
 	memset(idleCp, 0, sizeof(struct context));
 	idleCp->fs = 0x10;
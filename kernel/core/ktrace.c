@@ -0,0 +1,288 @@
+/*
+  ----- ktrace.c -----
+
+  Description..: Binary event trace. Events are framed into a byte
+	  ring with interrupts off, so any code, including interrupt
+	  handlers, can emit them; the idle process sends the ring to a
+	  dedicated port. See ktrace.h for the frame layout.
+*/
+
+#include <system.h>
+
+#include <core/klog.h>
+#include <core/ktrace.h>
+#include <core/serial.h>
+#include <mem/heapProfile.h>
+
+u32int ktraceMask = 0;
+
+static u8int ring[KTRACE_BUFFER];
+static volatile u32int head = 0; //next byte written
+static u32int tail = 0; //next byte sent
+static volatile u32int lost = 0; //dropped since the last lost frame
+static u32int totalLost = 0;
+static u32int sent = 0;
+static int draining = 0;
+static int device = 0; //0 for none
+static int ownIrq = -1; //irq line of the trace port
+
+/**
+ * Adds a byte to a frame's CRC-16/CCITT.
+ *
+ * @param crc The CRC so far
+ * @param b The byte
+ * @return The new CRC
+ */
+static inline u16int crc16_add(u16int crc, u8int b) {
+	int i;
+	crc ^= b << 8;
+	for (i = 0; i < 8; i++)
+		crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+	return crc;
+}
+
+/**
+ * Chooses the device frames are sent to. Tracing stops while there is none.
+ *
+ * @param dev The device; a serial port or VIRTIO_CON, 0 for none
+ */
+void ktrace_set_device(int dev) {
+	serial_dev *port;
+	int i;
+
+	device = dev;
+	ownIrq = -1;
+	for (i = 1; (port = serial_get_dev(i)) != NULL; i++) {
+		if (port->port == dev)
+			ownIrq = port->irq;
+	}
+	if (dev == 0)
+		ktraceMask = 0;
+}
+
+/**
+ * Gets the device frames are sent to.
+ *
+ * @return The device, or 0 for none
+ */
+int ktrace_get_device() {
+	return device;
+}
+
+/**
+ * Tests if a device can carry the trace by itself. Frames are binary, so
+ * the port must not also take the console, the kernel log or the heap
+ * trace.
+ *
+ * @param dev The device
+ * @return True if it is a port nothing else writes to
+ */
+int ktrace_port_ok(int dev) {
+	return dev > 0 && dev != get_serial_out() && dev != get_serial_mirror()
+			&& dev != klog_get_device() && dev != getTraceDevice();
+}
+
+/**
+ * Chooses which classes of events are traced. Turning tracing on sends a
+ * clock frame first, so the decoder can turn cycles into time.
+ *
+ * @param mask KTRACE_* classes, 0 to stop
+ */
+void ktrace_set_mask(u32int mask) {
+	u32int rate;
+
+	if (device == 0)
+		mask = 0;
+	if (mask != 0 && ktraceMask == 0) {
+		rate = tsc_per_ms();
+		ktrace_event(KTRACE_EV_CLOCK, &rate, sizeof(rate));
+	}
+	ktraceMask = mask;
+}
+
+/**
+ * Builds a frame and copies it into the ring. Interrupts must be off.
+ *
+ * @param type The KTRACE_EV_* type
+ * @param payload The payload
+ * @param len The payload length
+ * @return True if there was room
+ */
+static int ktrace_put(int type, const u8int *payload, int len) {
+	u8int frame[KTRACE_MAX_FRAME];
+	u32int lo, hi;
+	u16int crc = 0xFFFF;
+	int size = KTRACE_HEADER + len + 2;
+	int i;
+
+	if (KTRACE_BUFFER - (head - tail) < (u32int) size)
+		return 0;
+
+	asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+	frame[0] = KTRACE_SYNC;
+	frame[1] = type;
+	frame[2] = len;
+	for (i = 0; i < 4; i++) {
+		frame[3 + i] = lo >> (8 * i);
+		frame[7 + i] = hi >> (8 * i);
+	}
+	for (i = 0; i < len; i++)
+		frame[KTRACE_HEADER + i] = payload[i];
+	for (i = 1; i < KTRACE_HEADER + len; i++)
+		crc = crc16_add(crc, frame[i]);
+	frame[KTRACE_HEADER + len] = crc & 0xFF;
+	frame[KTRACE_HEADER + len + 1] = crc >> 8;
+
+	for (i = 0; i < size; i++)
+		ring[(head + i) & (KTRACE_BUFFER - 1)] = frame[i];
+	head += size;
+	return 1;
+}
+
+/**
+ * Reports the events dropped since the last report, if there is room.
+ * Interrupts must be off.
+ */
+static void ktrace_put_lost() {
+	u32int count = lost;
+	if (count != 0 && ktrace_put(KTRACE_EV_LOST, (const u8int *) &count, sizeof(count)))
+		lost = 0;
+}
+
+/**
+ * Adds a frame to the buffer. Safe from an interrupt handler. If there is
+ * no room the event is counted as lost and reported by a later frame.
+ *
+ * @param type The KTRACE_EV_* type
+ * @param payload The payload
+ * @param len The payload length, at most KTRACE_MAX_PAYLOAD
+ */
+void ktrace_event(int type, const void *payload, int len) {
+	int was_on = irq_on();
+
+	if (len > KTRACE_MAX_PAYLOAD)
+		return;
+
+	cli();
+	ktrace_put_lost();
+	if (!ktrace_put(type, (const u8int *) payload, len)) {
+		lost++;
+		totalLost++;
+	}
+	if (was_on) sti();
+}
+
+/**
+ * Records a switch between processes.
+ *
+ * @param from The pid switched from, -1 for the kernel
+ * @param to The pid switched to, -1 for the kernel
+ * @param op The system call op code that caused it
+ */
+void ktrace_sched(int from, int to, int op) {
+	u8int payload[9];
+	int i;
+	for (i = 0; i < 4; i++) {
+		payload[i] = (u32int) from >> (8 * i);
+		payload[4 + i] = (u32int) to >> (8 * i);
+	}
+	payload[8] = op;
+	ktrace_event(KTRACE_EV_SCHED, payload, sizeof(payload));
+}
+
+/**
+ * Records a heap allocation.
+ *
+ * @param addr The block address
+ * @param size The size
+ */
+void ktrace_alloc(u32int addr, u32int size) {
+	u32int payload[2] = {addr, size};
+	ktrace_event(KTRACE_EV_ALLOC, payload, sizeof(payload));
+}
+
+/**
+ * Records a heap free.
+ *
+ * @param addr The block address
+ */
+void ktrace_free(u32int addr) {
+	ktrace_event(KTRACE_EV_FREE, &addr, sizeof(addr));
+}
+
+/**
+ * Records an interrupt. Interrupts on the trace port's own line are not
+ * recorded, since sending the frames would cause more of them.
+ *
+ * @param irq The irq line
+ */
+void ktrace_irq(int irq) {
+	u8int line = irq;
+	if (irq != ownIrq)
+		ktrace_event(KTRACE_EV_IRQ, &line, sizeof(line));
+}
+
+/**
+ * Sends the buffered frames to the trace device. Does nothing if a drain
+ * is already running.
+ */
+void ktrace_drain() {
+	u32int end, start, chunk;
+	int was_on = irq_on();
+
+	cli();
+	if (draining || device == 0) {
+		if (was_on) sti();
+		return;
+	}
+	draining = 1;
+	if (was_on) sti();
+
+	while (1) {
+		//report drops first; there is room once the last pass was sent
+		cli();
+		ktrace_put_lost();
+		if (was_on) sti();
+		if (tail == head)
+			break;
+
+		end = head;
+		while (tail != end) {
+			start = tail & (KTRACE_BUFFER - 1);
+			chunk = end - tail;
+			if (start + chunk > KTRACE_BUFFER)
+				chunk = KTRACE_BUFFER - start; //up to the end of the ring first
+			serial_write_device(device, (const char *) ring + start, chunk);
+			tail += chunk;
+			sent += chunk;
+		}
+	}
+	draining = 0;
+}
+
+/**
+ * Tests if there are frames waiting to be sent.
+ *
+ * @return True if there is something to drain
+ */
+int ktrace_pending() {
+	return device != 0 && (tail != head || lost != 0);
+}
+
+/**
+ * Gets the number of bytes of frames sent.
+ *
+ * @return The number of bytes
+ */
+u32int ktrace_sent() {
+	return sent;
+}
+
+/**
+ * Gets the number of events dropped because the buffer was full.
+ *
+ * @return The number of events
+ */
+u32int ktrace_lost() {
+	return totalLost;
+}
@@ -10,6 +10,9 @@
 #include <modules/mpx_supt.h>
 #include <system.h>
 #include <core/pcb.h>
+#include <mem/stack.h>
+
+int nextPid = 1; //pid 0 is the kernel
 
 /**
  * Allocates memory for a new PCB and returns a pointer to it
@@ -21,21 +24,37 @@
 pcb *allocatePCB() {
 	pcb *newPCB = NULL;
 	newPCB = sys_alloc_mem(sizeof(struct pcb)); //malloc
+	if (newPCB == NULL) {
+		return NULL;
+	}
 	newPCB->processName = sys_alloc_mem(sizeof(char) * 256);
-	newPCB->stackBottom = sys_alloc_mem(sizeof(unsigned char) * 4096);
-	newPCB->stackTop = newPCB->stackBottom + (sizeof(unsigned char) * 4096) - sizeof(struct context);
+	if (newPCB->processName == NULL) {
+		sys_free_mem(newPCB);
+		return NULL;
+	}
+	//stacks get their own slot above a guard page and grow on demand
+	u32int stackBase = alloc_stack(STACK_DEFAULT_LIMIT);
+	if (stackBase == 0) {
+		sys_free_mem(newPCB->processName);
+		sys_free_mem(newPCB);
+		return NULL;
+	}
+	newPCB->stackBottom = (unsigned char *) (stackBase - STACK_DEFAULT_LIMIT);
+	newPCB->stackTop = (unsigned char *) stackBase - sizeof(struct context);
 	return newPCB;
 }
 
 /**
- * Frees memory that is allocated for the pcb provided
+ * Frees memory that is allocated for the pcb provided. The stack is
+ * left alone if stackBottom was cleared, for a process still running on it.
  *
  * @param pcbPtr pointer to pcb to be freed
  * @return integer code - 1 if successful, 0 otherwise
  */
 int freePCB(pcb *pcbPtr) {
-	sys_free_mem(pcbPtr->stackTop);
-	sys_free_mem(pcbPtr->stackBottom);
+	if (pcbPtr->stackBottom != NULL) {
+		free_stack((u32int) pcbPtr->stackBottom);
+	}
 	sys_free_mem(pcbPtr->processName);
 	int ret = sys_free_mem(pcbPtr); //TODO Mod5 confirm works
 	if (ret != -1) { //if returns value not -1 memory was released
@@ -57,13 +76,23 @@ pcb *setupPCB(const char *processName, int processClass, int priority) {
 		return NULL;
 	}
 	pcb *newPCB = allocatePCB(); //allocate mem
+	if (newPCB == NULL) { //out of memory
+		return NULL;
+	}
 	strcpy(newPCB->processName, processName); //set values
 	newPCB->processClass = processClass;
 	newPCB->priority = priority;
 
+	newPCB->pid = nextPid++;
+
 	newPCB->isSuspended = 0; //set to defaults
 	newPCB->state = READY;
 
+	newPCB->mem.bytes = 0; //owns no memory yet
+	newPCB->mem.blocks = 0;
+	newPCB->mem.quota = 0;
+	newPCB->mem.blockList = NULL;
+
 	return newPCB;
 }
 
@@ -0,0 +1,164 @@
+/*
+  ----- pci.c -----
+
+  Description..: PCI bus enumeration through configuration
+	  mechanism #1 (ports 0xCF8/0xCFC).
+*/
+
+#include <system.h>
+
+#include <core/io.h>
+#include <core/pci.h>
+
+static pci_device devices[PCI_MAX_DEVICES];
+static int numDevices = 0;
+
+/**
+ * Selects a configuration space double word.
+ *
+ * @param bus The bus
+ * @param slot The slot
+ * @param func The function
+ * @param offset The offset
+ */
+static void pci_select(int bus, int slot, int func, int offset) {
+	u32int address = 0x80000000 | (bus << 16) | (slot << 11) | (func << 8) | (offset & 0xFC);
+	outl(PCI_CONFIG_ADDRESS, address);
+}
+
+/**
+ * Reads a double word from a function's configuration space.
+ *
+ * @param bus The bus
+ * @param slot The slot
+ * @param func The function
+ * @param offset The offset; rounded down to a multiple of 4
+ * @return The value
+ */
+u32int pci_read32(int bus, int slot, int func, int offset) {
+	pci_select(bus, slot, func, offset);
+	return inl(PCI_CONFIG_DATA);
+}
+
+/**
+ * Reads a word from a function's configuration space.
+ *
+ * @param bus The bus
+ * @param slot The slot
+ * @param func The function
+ * @param offset The offset; rounded down to a multiple of 2
+ * @return The value
+ */
+u16int pci_read16(int bus, int slot, int func, int offset) {
+	pci_select(bus, slot, func, offset);
+	return inw(PCI_CONFIG_DATA + (offset & 2));
+}
+
+/**
+ * Writes a word to a function's configuration space.
+ *
+ * @param bus The bus
+ * @param slot The slot
+ * @param func The function
+ * @param offset The offset; rounded down to a multiple of 2
+ * @param value The value
+ */
+void pci_write16(int bus, int slot, int func, int offset, u16int value) {
+	pci_select(bus, slot, func, offset);
+	outw(PCI_CONFIG_DATA + (offset & 2), value);
+}
+
+/**
+ * Records one function.
+ *
+ * @param bus The bus
+ * @param slot The slot
+ * @param func The function
+ */
+static void pci_add(int bus, int slot, int func) {
+	pci_device *dev;
+	u32int classReg;
+	int i;
+
+	if (numDevices == PCI_MAX_DEVICES)
+		return;
+
+	dev = &devices[numDevices++];
+	dev->bus = bus;
+	dev->slot = slot;
+	dev->func = func;
+	dev->vendor = pci_read16(bus, slot, func, PCI_VENDOR_ID);
+	dev->device = pci_read16(bus, slot, func, PCI_DEVICE_ID);
+	dev->subsystem = pci_read16(bus, slot, func, PCI_SUBSYSTEM);
+	classReg = pci_read32(bus, slot, func, PCI_REVISION);
+	dev->classCode = classReg >> 24;
+	dev->subclass = (classReg >> 16) & 0xFF;
+	dev->irq = pci_read32(bus, slot, func, PCI_IRQ_LINE) & 0xFF;
+	for (i = 0; i < 6; i++)
+		dev->bar[i] = pci_read32(bus, slot, func, PCI_BAR0 + 4 * i);
+}
+
+/**
+ * Scans every bus and records the functions found.
+ *
+ * @return The number of functions found
+ */
+int pci_enumerate() {
+	int bus, slot, func, funcs;
+
+	numDevices = 0;
+	for (bus = 0; bus < 256; bus++) {
+		for (slot = 0; slot < 32; slot++) {
+			if (pci_read16(bus, slot, 0, PCI_VENDOR_ID) == PCI_NO_DEVICE)
+				continue;
+
+			//function 0 says whether the others are worth probing
+			funcs = (pci_read32(bus, slot, 0, PCI_HEADER_TYPE) >> 16) & PCI_HEADER_MULTI ? 8 : 1;
+			for (func = 0; func < funcs; func++) {
+				if (pci_read16(bus, slot, func, PCI_VENDOR_ID) != PCI_NO_DEVICE)
+					pci_add(bus, slot, func);
+			}
+		}
+	}
+	return numDevices;
+}
+
+/**
+ * Finds a function by its vendor and device ids.
+ *
+ * @param vendor The vendor id
+ * @param device The device id
+ * @return The function, or NULL if none was found
+ */
+pci_device *pci_find(u16int vendor, u16int device) {
+	int i;
+	for (i = 0; i < numDevices; i++) {
+		if (devices[i].vendor == vendor && devices[i].device == device)
+			return &devices[i];
+	}
+	return NULL;
+}
+
+/**
+ * Gets a function found by the last scan.
+ *
+ * @param index 0 to the number found - 1
+ * @return The function, or NULL past the end
+ */
+pci_device *pci_get(int index) {
+	if (index < 0 || index >= numDevices)
+		return NULL;
+	return &devices[index];
+}
+
+/**
+ * Turns on I/O decoding and bus mastering, so the function can answer
+ * port accesses and do DMA.
+ *
+ * @param dev The function
+ */
+void pci_enable(pci_device *dev) {
+	u16int command = pci_read16(dev->bus, dev->slot, dev->func, PCI_COMMAND);
+	command |= PCI_COMMAND_IO | PCI_COMMAND_MASTER;
+	pci_write16(dev->bus, dev->slot, dev->func, PCI_COMMAND, command);
+}
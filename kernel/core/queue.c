@@ -35,7 +35,10 @@ node *_newNode(pcb *pcb) {
 	}
 
 	// Allocate memory for the node
-	node *node = sys_alloc_mem(sizeof(struct node));	//TODO: Make sure memory allocates
+	node *node = sys_alloc_mem(sizeof(struct node));
+	if (node == NULL) {
+		return NULL;
+	}
 
 	// Initiailize the node pointers
 	node->data = pcb;
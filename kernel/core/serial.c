@@ -8,33 +8,429 @@
 #include <stdint.h>
 #include <string.h>
 
+#include <system.h>
 #include <core/io.h>
 #include <core/serial.h>
+#include <core/tables.h>
+#include <core/vga.h>
+#include <core/virtio.h>
+#include <core/interrupts.h>
+#include <core/ktrace.h>
+#include <modules/mpx_supt.h>
 
 #define NO_ERROR 0
 
 // Active devices used for serial I/O
 int serial_port_out = 0;
 int serial_port_in = 0;
+int serial_port_mirror = 0; //second output device, 0 for none
+
+// Device table, indexed by port number - 1
+serial_dev serial_devs[SERIAL_PORTS] = {
+		{COM1, 4, 0, 0, 0, 0, 0, {{0}, 0, 0}, {{0}, 0, 0}},
+		{COM2, 3, 0, 0, 0, 0, 0, {{0}, 0, 0}, {{0}, 0, 0}},
+		{COM3, 4, 0, 0, 0, 0, 0, {{0}, 0, 0}, {{0}, 0, 0}},
+		{COM4, 3, 0, 0, 0, 0, 0, {{0}, 0, 0}, {{0}, 0, 0}}
+};
+#define NUM_SERIAL_DEVS SERIAL_PORTS
+
+// Interrupt stubs; defined in irq.s
+extern void serial_irq3();
+extern void serial_irq4();
+
+/**
+ * Finds the interrupt-driven state of a device.
+ *
+ * @param device The device
+ * @return The device state, or NULL if the device has none
+ */
+serial_dev *serial_find(int device) {
+	int i;
+	for (i = 0; i < NUM_SERIAL_DEVS; i++) {
+		if (serial_devs[i].port == device)
+			return &serial_devs[i];
+	}
+	return NULL;
+}
+
+/**
+ * Adds a character to a ring. Only one side may call this for a ring.
+ *
+ * @param ring The ring
+ * @param c The character
+ * @return 1 if added, 0 if the ring is full
+ */
+int ring_put(serial_ring *ring, char c) {
+	if (ring->head - ring->tail == SERIAL_RING_SIZE)
+		return 0;
+	ring->buf[ring->head % SERIAL_RING_SIZE] = c;
+	asm volatile ("":::"memory"); //publish the character before the index
+	ring->head++;
+	return 1;
+}
+
+/**
+ * Takes a character from a ring. Only one side may call this for a ring.
+ *
+ * @param ring The ring
+ * @param c Set to the character
+ * @return 1 if a character was taken, 0 if the ring is empty
+ */
+int ring_get(serial_ring *ring, char *c) {
+	if (ring->head == ring->tail)
+		return 0;
+	*c = ring->buf[ring->tail % SERIAL_RING_SIZE];
+	asm volatile ("":::"memory"); //read the character before freeing its slot
+	ring->tail++;
+	return 1;
+}
+
+/**
+ * Checks whether a UART is fitted at a port by writing and reading back
+ * its scratch register. Records the result in the device table.
+ *
+ * @param device The device
+ * @return True if the UART is there
+ */
+int serial_probe(int device) {
+	serial_dev *dev = serial_find(device);
+	int present;
+
+	outb(device + 7, SERIAL_PROBE_BYTE);
+	present = inb(device + 7) == SERIAL_PROBE_BYTE;
+	if (dev != NULL)
+		dev->present = present;
+	return present;
+}
+
+/**
+ * Gets the address of a port from its number.
+ *
+ * @param number 1 to SERIAL_PORTS
+ * @return The address, or 0 if there is no such port
+ */
+int serial_port(int number) {
+	if (number < 1 || number > NUM_SERIAL_DEVS)
+		return 0;
+	return serial_devs[number - 1].port;
+}
+
+/**
+ * Gets the driver state of a port in the device table.
+ *
+ * @param number 1 to SERIAL_PORTS
+ * @return The state, or NULL if there is no such port
+ */
+serial_dev *serial_get_dev(int number) {
+	if (number < 1 || number > NUM_SERIAL_DEVS)
+		return NULL;
+	return &serial_devs[number - 1];
+}
+
+/**
+ * Looks up an output device by the name commands and boot options give
+ * it: a port number, 0 for the console, or virtio.
+ *
+ * @param name The name
+ * @return The device, 0 for the console, or -1 if it is not there
+ */
+int serial_lookup(const char *name) {
+	serial_dev *dev;
+
+	if (strcmp(name, "virtio") == 0)
+		return virtio_console_ready() ? VIRTIO_CON : -1;
+	if (strcmp(name, "0") == 0)
+		return 0;
+	dev = serial_get_dev(atoi(name));
+	return dev != NULL && dev->present ? dev->port : -1;
+}
+
+/**
+ * Writes a character once the transmit holding register is empty.
+ *
+ * @param device The device
+ * @param c The character
+ */
+void serial_putc_polled(int device, char c) {
+	while (!(inb(device + 5) & LSR_THRE));
+	outb(device, c);
+}
+
+/**
+ * Turns transmit interrupts on if they are off, so the transmitter starts
+ * taking characters from the ring.
+ *
+ * @param dev The device
+ */
+void serial_start_tx(serial_dev *dev) {
+	//the first character after the ring drained restarts the transmitter
+	if (!dev->tx_active) {
+		cli();
+		if (!dev->tx_active) {
+			dev->tx_active = 1;
+			outb(dev->port + 1, IER_RDA | IER_THRE);
+		}
+		sti();
+	}
+}
+
+/**
+ * Writes a character to a device. Goes through the transmit ring when the
+ * device is interrupt-driven and interrupts are on; otherwise, as during
+ * boot or a panic, waits for the transmitter after draining the ring.
+ *
+ * @param device The device
+ * @param c The character
+ */
+void serial_putc(int device, char c) {
+	serial_dev *dev = serial_find(device);
+	char queued;
+
+	if (device == VGA) {
+		vga_write(&c, 1);
+		return;
+	}
+	if (device == VIRTIO_CON) {
+		serial_write_device(device, &c, 1);
+		return;
+	}
+	if (dev == NULL || !dev->irq_enabled || !irq_on()) {
+		if (dev != NULL && !irq_on()) {
+			while (ring_get(&dev->tx, &queued))
+				serial_putc_polled(device, queued);
+		}
+		serial_putc_polled(device, c);
+		return;
+	}
+
+	while (!ring_put(&dev->tx, c)); //the transmit interrupt makes room
+	serial_start_tx(dev);
+}
+
+/**
+ * Handles an interrupt from one device: reads what has arrived into the
+ * receive ring, and refills the transmit FIFO from the transmit ring.
+ *
+ * @param dev The device
+ * @return The number of interrupt causes handled
+ */
+int serial_service(serial_dev *dev) {
+	u8int iir;
+	char c;
+	int i, handled = 0;
+
+	while (!((iir = inb(dev->port + 2)) & IIR_NONE)) {
+		handled++;
+		switch (iir & IIR_ID) {
+			case IIR_RDA:
+			case IIR_TIMEOUT:
+				while (inb(dev->port + 5) & LSR_DR) {
+					c = inb(dev->port);
+					if (!ring_put(&dev->rx, c))
+						dev->rx_dropped++;
+				}
+				break;
+			case IIR_THRE:
+				for (i = 0; i < SERIAL_FIFO_SIZE && ring_get(&dev->tx, &c); i++)
+					outb(dev->port, c);
+				if (i == 0) { //nothing left to send
+					dev->tx_active = 0;
+					outb(dev->port + 1, IER_RDA);
+				}
+				break;
+			case IIR_LINE:
+				(void) inb(dev->port + 5);
+				break;
+			default:
+				(void) inb(dev->port + 6);
+				break;
+		}
+	}
+	return handled;
+}
+
+/**
+ * Serial interrupt handler, called from the stubs in irq.s. Ports sharing
+ * the line are serviced until none has an interrupt pending: the line is
+ * edge triggered, so one that raised another while a later port was being
+ * serviced would not make a new edge and would never be seen.
+ *
+ * @param irq The IRQ line that fired
+ */
+void do_serial_irq(int irq) {
+	int handled, i;
+	if (ktrace_on(KTRACE_IRQ))
+		ktrace_irq(irq);
+	do {
+		handled = 0;
+		for (i = 0; i < NUM_SERIAL_DEVS; i++) {
+			if (serial_devs[i].irq == irq && serial_devs[i].irq_enabled)
+				handled += serial_service(&serial_devs[i]);
+		}
+	} while (handled != 0);
+	pic_eoi(irq);
+}
+
+/**
+ * Switches a device to interrupt-driven I/O. The PIC must have been
+ * initialized.
+ *
+ * @param device The device
+ * @return The error code
+ */
+int serial_enable_irq(int device) {
+	serial_dev *dev = serial_find(device);
+	if (dev == NULL)
+		return -1;
+
+	idt_set_gate(PIC_VECTOR_BASE + dev->irq, dev->irq == 4 ? (u32int) serial_irq4 : (u32int) serial_irq3, 0x08, 0x8e);
+	dev->irq_enabled = 1;
+	outb(device + 1, IER_RDA); //transmit interrupts are turned on as output is queued
+	pic_unmask(dev->irq);
+	return NO_ERROR;
+}
+
+/**
+ * Checks whether input is waiting on the active input device.
+ *
+ * @return True if a character can be read without blocking
+ */
+int serial_input_pending() {
+	serial_dev *dev = serial_find(serial_port_in);
+	if (dev == NULL || !dev->irq_enabled)
+		return inb(serial_port_in + 5) & LSR_DR;
+	return dev->rx.head != dev->rx.tail;
+}
+
+/**
+ * Reads a character from the active input device without blocking.
+ *
+ * @param c Set to the character read
+ * @return 1 if a character was read, 0 if none was waiting
+ */
+int serial_poll(char *c) {
+	serial_dev *dev = serial_find(serial_port_in);
+	if (dev == NULL || !dev->irq_enabled) {
+		if (!(inb(serial_port_in + 5) & LSR_DR))
+			return 0;
+		*c = inb(serial_port_in);
+		return 1;
+	}
+	return ring_get(&dev->rx, c);
+}
+
+/**
+ * Reads a character from the active input device. A running process is
+ * blocked until the receive interrupt brings input.
+ *
+ * @return The character read
+ */
+char serial_getc() {
+	char c;
+	while (!serial_poll(&c)) {
+		if (getCOP() != NULL)
+			sys_req(READ);
+	}
+	return c;
+}
+
+/**
+ * Checks a line speed and finds its divisor.
+ *
+ * @param baud The line speed
+ * @return The divisor, or 0 if the UART cannot run at exactly that speed
+ */
+int serial_divisor(int baud) {
+	if (baud <= 0 || baud > SERIAL_MAX_BAUD || SERIAL_MAX_BAUD % baud != 0)
+		return 0;
+	return SERIAL_MAX_BAUD / baud;
+}
+
+/**
+ * Programs the divisor latch. Leaves the line at 8 bits, no parity, one
+ * stop bit; the interrupt enable register is not touched.
+ *
+ * @param device The device
+ * @param divisor The divisor
+ */
+void serial_write_divisor(int device, int divisor) {
+	outb(device + 3, 0x80); //set line control register
+	outb(device + 0, divisor & 0xFF); //set bsd least sig bit
+	outb(device + 1, (divisor >> 8) & 0xFF); //brd most significant bit
+	outb(device + 3, 0x03); //lock divisor; 8bits, no parity, one stop
+}
 
 /**
  * Initializes devices for user interaction, logging, ...
  *
  * @param device The device to initialize
+ * @param baud The line speed; must divide SERIAL_MAX_BAUD
  * @return The error code
  */
-int init_serial(int device) {
+int init_serial(int device, int baud) {
+	serial_dev *dev = serial_find(device);
+	int divisor = serial_divisor(baud);
+
+	if (divisor == 0)
+		return SERIAL_BAD_BAUD;
+
 	outb(device + 1, 0x00); //disable interrupts
-	outb(device + 3, 0x80); //set line control register
-	outb(device + 0, 115200 / 9600); //set bsd least sig bit
-	outb(device + 1, 0x00); //brd most significant bit
-	outb(device + 3, 0x03); //lock divisor; 8bits, no parity, one stop
+	serial_write_divisor(device, divisor);
 	outb(device + 2, 0xC7); //enable fifo, clear, 14byte threshold
 	outb(device + 4, 0x0B); //enable interrupts, rts/dsr set
 	(void) inb(device);      //read bit to reset port
+	if (dev != NULL)
+		dev->baud = baud;
+	return NO_ERROR;
+}
+
+/**
+ * Waits until everything queued for a device has left the transmitter.
+ *
+ * @param device The device
+ */
+void serial_flush(int device) {
+	serial_dev *dev = serial_find(device);
+	while (dev != NULL && dev->irq_enabled && irq_on() && dev->tx.head != dev->tx.tail);
+	while (!(inb(device + 5) & LSR_TEMT));
+}
+
+/**
+ * Changes the line speed of an initialized device. Output already queued
+ * is sent at the old speed first.
+ *
+ * @param device The device
+ * @param baud The new line speed; must divide SERIAL_MAX_BAUD
+ * @return The error code
+ */
+int serial_set_baud(int device, int baud) {
+	serial_dev *dev = serial_find(device);
+	int divisor = serial_divisor(baud);
+	int was_on = irq_on();
+
+	if (divisor == 0)
+		return SERIAL_BAD_BAUD;
+
+	serial_flush(device);
+	cli();
+	serial_write_divisor(device, divisor);
+	if (was_on) sti();
+	if (dev != NULL)
+		dev->baud = baud;
 	return NO_ERROR;
 }
 
+/**
+ * Returns the line speed a device was last set to.
+ *
+ * @param device The device
+ * @return The line speed, or 0 if unknown
+ */
+int serial_get_baud(int device) {
+	serial_dev *dev = serial_find(device);
+	return dev == NULL ? 0 : dev->baud;
+}
+
 /**
  * Writes a message to the active serial output device.
  *Appends a newline character.
@@ -43,12 +439,63 @@ int init_serial(int device) {
  * @return The error code
  */
 int serial_println(const char *msg) {
+	serial_write(msg, strlen(msg));
+	serial_write("\r\n", 2);
+	return NO_ERROR;
+}
+
+/**
+ * Writes a block of characters to one device, whatever the active
+ * output device is. For a serial port the block is queued as a whole and
+ * the transmitter is started once; the VGA and virtio consoles take it in
+ * one call. Writes to a virtio console that is not there, or that has
+ * stalled, go to COM1.
+ *
+ * @param device The device
+ * @param buf The characters
+ * @param len The number of characters
+ */
+void serial_write_device(int device, const char *buf, int len) {
+	serial_dev *dev = serial_find(device);
 	int i;
-	for (i = 0; *(i + msg) != '\0'; i++) {
-		outb(serial_port_out, *(i + msg));
+
+	if (device == VGA) {
+		vga_write(buf, len);
+		return;
+	}
+	if (device == VIRTIO_CON) {
+		i = virtio_console_write(buf, len);
+		if (i < len) //not there or stalled; the rest goes to COM1
+			serial_write_device(COM1, buf + i, len - i);
+		return;
+	}
+
+	if (dev == NULL || !dev->irq_enabled || !irq_on()) {
+		for (i = 0; i < len; i++)
+			serial_putc(device, buf[i]);
+		return;
+	}
+
+	for (i = 0; i < len; i++) {
+		while (!ring_put(&dev->tx, buf[i]))
+			serial_start_tx(dev); //full; let the transmitter make room
 	}
-	outb(serial_port_out, '\r');
-	outb(serial_port_out, '\n');
+	serial_start_tx(dev);
+}
+
+/**
+ * Writes a block of characters to the active serial output device, and
+ * to the mirror device if there is one. The block is queued as a whole
+ * and the transmitter is started once, rather than once per character.
+ *
+ * @param buf The characters
+ * @param len The number of characters
+ * @return The error code
+ */
+int serial_write(const char *buf, int len) {
+	serial_write_device(serial_port_out, buf, len);
+	if (serial_port_mirror != 0 && serial_port_mirror != serial_port_out)
+		serial_write_device(serial_port_mirror, buf, len);
 	return NO_ERROR;
 }
 
@@ -59,11 +506,8 @@ int serial_println(const char *msg) {
  * @return  The error code
  */
 int serial_print(const char *msg) {
-	int i;
-	for (i = 0; *(i + msg) != '\0'; i++) {
-		outb(serial_port_out, *(i + msg));
-	}
-	if (*msg == '\r') outb(serial_port_out, '\n');
+	serial_write(msg, strlen(msg));
+	if (*msg == '\r') serial_write("\n", 1);
 	return NO_ERROR;
 }
 
@@ -80,6 +524,36 @@ int set_serial_out(int device) {
 	return NO_ERROR;
 }
 
+/**
+ * Sets serial_port_mirror to the given device address. Everything
+ * written to the output device is written to this device as well.
+ *
+ * @param device The device to mirror output to, or 0 for none
+ * @return The error code
+ */
+int set_serial_mirror(int device) {
+	serial_port_mirror = device;
+	return NO_ERROR;
+}
+
+/**
+ * Gets the active output device.
+ *
+ * @return The device
+ */
+int get_serial_out() {
+	return serial_port_out;
+}
+
+/**
+ * Gets the device output is mirrored to.
+ *
+ * @return The device, or 0 for none
+ */
+int get_serial_mirror() {
+	return serial_port_mirror;
+}
+
 /**
  * Sets serial_port_in to the given device address. All serial input,
  * such as console input via a virutal machine, QEMU/Bochc/etc, will
@@ -1,18 +1,52 @@
 #include <string.h>
 #include <system.h>
 
+#include <core/io.h>
+#include <core/klog.h>
 #include <core/serial.h>
+#include <modules/mpx_supt.h>
+
+// Cycles per millisecond, measured once
+static u32int tscPerMs = 0;
 
 /**
- * Kernel log message. Sent to active serial device.
+ * Measures how many time stamp counter cycles make up a millisecond by
+ * timing a 10ms one-shot on PIT channel 2. The result is cached.
+ *
+ * @return The number of cycles per millisecond
+ */
+u32int tsc_per_ms() {
+	u32int start;
+	u8int gate;
+
+	if (tscPerMs != 0)
+		return tscPerMs;
+
+	gate = inb(0x61);
+	outb(0x61, (gate & ~0x02) | 0x01); //gate channel 2 on, speaker off
+	outb(0x43, 0xB0); //channel 2, lobyte/hibyte, mode 0
+	outb(0x42, PIT_HZ / 100 & 0xFF);
+	outb(0x42, PIT_HZ / 100 >> 8);
+	start = rdtsc();
+	while (!(inb(0x61) & 0x20)); //output goes high when the count ends
+	tscPerMs = (rdtsc() - start) / 10;
+	outb(0x61, gate);
+
+	if (tscPerMs == 0)
+		tscPerMs = 1;
+	return tscPerMs;
+}
+
+/**
+ * Kernel log message, at info level from the core. Until the dispatcher
+ * is running nothing else drains the log, so it is printed right away.
  *
  * @param msg The message to log
  */
 void klogv(const char *msg) {
-	char logmsg[512] = {'\0'}, prefix[] = "klogv: ";
-	strcat(logmsg, prefix);
-	strcat(logmsg, msg);
-	serial_println(logmsg);
+	klog(KLOG_CORE, KLOG_INFO, msg);
+	if (getCOP() == NULL)
+		klog_drain();
 }
 
 /**
@@ -25,6 +59,7 @@ void kpanic(const char *msg) {
 	char logmsg[512] = {'\0'}, prefix[] = "\nPanic: ";
 	strcat(logmsg, prefix);
 	strcat(logmsg, msg);
-	klogv(logmsg);
+	klog_drain(); //whatever was logged before the panic comes first
+	serial_println(logmsg);
 	hlt(); //halt
 }
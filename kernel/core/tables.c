@@ -10,7 +10,12 @@
 
 // Global Descriptor Table
 gdt_descriptor gdt_ptr;
-gdt_entry gdt_entries[5];
+gdt_entry gdt_entries[7];
+
+// Task State Segments
+tss_entry kernel_tss;
+tss_entry fault_tss;
+u8int fault_stack[FAULT_STACK_SIZE];
 
 // Interrupt Descriptor Table
 idt_descriptor idt_ptr;
@@ -20,6 +25,9 @@ idt_entry idt_entries[256];
 extern void write_gdt_ptr(u32int, size_t);
 extern void write_idt_ptr(u32int);
 
+// Page fault task entry point; defined in irq.s
+extern void page_fault();
+
 /**
  * Installs a new gate entry into the IDT.
  *
@@ -70,12 +78,46 @@ void gdt_init_entry(int idx, u32int base, u32int limit,
 	new_entry->access = access;
 }
 
+/**
+ * Fills in the task state the page fault task starts from. Segment
+ * registers are the kernel's; interrupts stay off while it runs.
+ */
+void init_fault_tss() {
+	memset(&kernel_tss, 0, sizeof(tss_entry));
+	kernel_tss.iomap_base = sizeof(tss_entry);
+
+	memset(&fault_tss, 0, sizeof(tss_entry));
+	fault_tss.eip = (u32int) page_fault;
+	fault_tss.eflags = 0x2;
+	fault_tss.esp = (u32int) (fault_stack + FAULT_STACK_SIZE);
+	fault_tss.cs = GDT_CS_ID << 3;
+	fault_tss.ds = GDT_DS_ID << 3;
+	fault_tss.es = GDT_DS_ID << 3;
+	fault_tss.fs = GDT_DS_ID << 3;
+	fault_tss.gs = GDT_DS_ID << 3;
+	fault_tss.ss = GDT_DS_ID << 3;
+	fault_tss.iomap_base = sizeof(tss_entry);
+}
+
+/**
+ * Sets the page directory the page fault task and the kernel task run
+ * with. Called whenever the directory changes. A task switch does not
+ * save CR3, so the kernel task's must be set for the return to it.
+ *
+ * @param cr3 The physical address of the page directory
+ */
+void set_fault_task_cr3(u32int cr3) {
+	fault_tss.cr3 = cr3;
+	kernel_tss.cr3 = cr3;
+}
+
 /**
  * Creates the global descriptor table and installs it using the defined
- * assembly routine.
+ * assembly routine. Also sets up the kernel and page fault task state
+ * segments and loads the task register.
  */
 void init_gdt() {
-	gdt_ptr.limit = 5 * sizeof(gdt_entry) - 1;
+	gdt_ptr.limit = 7 * sizeof(gdt_entry) - 1;
 	gdt_ptr.base = (u32int) gdt_entries;
 
 	u32int limit = 0xFFFFFFFF;
@@ -85,5 +127,12 @@ void init_gdt() {
 	gdt_init_entry(3, 0, limit, 0xFA, 0xCF); //user mode code segment
 	gdt_init_entry(4, 0, limit, 0xF2, 0xCF); //user mode data segment
 
+	init_fault_tss();
+	gdt_init_entry(GDT_TSS_ID, (u32int) &kernel_tss, sizeof(tss_entry) - 1, 0x89, 0x00); //kernel task
+	gdt_init_entry(GDT_FAULT_TSS_ID, (u32int) &fault_tss, sizeof(tss_entry) - 1, 0x89, 0x00); //page fault task
+
 	write_gdt_ptr((u32int) & gdt_ptr, sizeof(gdt_ptr));
+
+	//the running kernel becomes the task a fault switches away from
+	asm volatile ("ltr %%ax"::"a"(GDT_TSS_ID << 3));
 }
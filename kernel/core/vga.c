@@ -0,0 +1,242 @@
+/*
+  ----- vga.c -----
+
+  Description..: VGA text mode console. Writes go straight into the
+	  frame buffer; a small parser turns the escape sequences the
+	  shell and commands send to a terminal into edits of the screen.
+*/
+
+#include <string.h>
+#include <system.h>
+
+#include <core/io.h>
+#include <core/vga.h>
+
+static volatile u16int *screen = (volatile u16int *) VGA_MEMORY;
+static int row = 0;
+static int col = 0;
+static u8int attr = VGA_DEFAULT_ATTR;
+
+// Escape sequence parser
+#define ESC_NONE 0
+#define ESC_SEEN 1 //ESC read, waiting for [
+#define ESC_CSI  2 //reading parameters
+static int escState = ESC_NONE;
+static int params[VGA_MAX_PARAMS];
+static int numParams = 0;
+
+// ANSI colour numbers in VGA order
+static const u8int ansiColours[8] = {0, 4, 2, 6, 1, 5, 3, 7};
+
+/**
+ * Fills part of a row with blanks in the current colour.
+ *
+ * @param r The row
+ * @param from The first column
+ * @param to One past the last column
+ */
+void vga_blank(int r, int from, int to) {
+	u16int blank = (attr << 8) | ' ';
+	int c;
+	for (c = from; c < to; c++)
+		screen[r * VGA_WIDTH + c] = blank;
+}
+
+/**
+ * Moves every row up one and blanks the bottom row.
+ */
+void vga_scroll() {
+	memmove((void *) screen, (void *) (screen + VGA_WIDTH),
+			(VGA_HEIGHT - 1) * VGA_WIDTH * sizeof(u16int));
+	vga_blank(VGA_HEIGHT - 1, 0, VGA_WIDTH);
+}
+
+/**
+ * Moves the cursor to the start of the next line, scrolling at the bottom.
+ */
+void vga_newline() {
+	col = 0;
+	if (++row == VGA_HEIGHT) {
+		vga_scroll();
+		row = VGA_HEIGHT - 1;
+	}
+}
+
+/**
+ * Moves the blinking hardware cursor to the console's cursor.
+ */
+void vga_move_cursor() {
+	u16int pos = row * VGA_WIDTH + col;
+	outb(VGA, VGA_CURSOR_HIGH);
+	outb(VGA_CRTC_DATA, pos >> 8);
+	outb(VGA, VGA_CURSOR_LOW);
+	outb(VGA_CRTC_DATA, pos & 0xFF);
+}
+
+/**
+ * Clears the screen and puts the cursor in the top left corner.
+ */
+void vga_init() {
+	int r;
+	attr = VGA_DEFAULT_ATTR;
+	for (r = 0; r < VGA_HEIGHT; r++)
+		vga_blank(r, 0, VGA_WIDTH);
+	row = 0;
+	col = 0;
+	escState = ESC_NONE;
+	vga_move_cursor();
+}
+
+/**
+ * Applies select graphic rendition parameters: 0 resets, 1 brightens,
+ * 30-37 set the foreground and 40-47 the background.
+ */
+void vga_sgr() {
+	int i, p;
+
+	if (numParams == 0)
+		attr = VGA_DEFAULT_ATTR;
+	for (i = 0; i < numParams; i++) {
+		p = params[i];
+		if (p == 0)
+			attr = VGA_DEFAULT_ATTR;
+		else if (p == 1)
+			attr |= 0x08;
+		else if (p >= 30 && p <= 37)
+			attr = (attr & 0xF8) | ansiColours[p - 30];
+		else if (p >= 40 && p <= 47)
+			attr = (attr & 0x8F) | (ansiColours[p - 40] << 4);
+	}
+}
+
+/**
+ * Carries out a complete control sequence.
+ *
+ * @param cmd The final character of the sequence
+ */
+void vga_csi(char cmd) {
+	int n = numParams > 0 && params[0] > 0 ? params[0] : 1;
+	u16int *line = (u16int *) screen + row * VGA_WIDTH;
+	int r;
+
+	switch (cmd) {
+		case 'A':
+			row = row - n < 0 ? 0 : row - n;
+			break;
+		case 'B':
+			row = row + n >= VGA_HEIGHT ? VGA_HEIGHT - 1 : row + n;
+			break;
+		case 'C':
+			col = col + n >= VGA_WIDTH ? VGA_WIDTH - 1 : col + n;
+			break;
+		case 'D':
+			col = col - n < 0 ? 0 : col - n;
+			break;
+		case 'H':
+		case 'f':
+			row = numParams > 0 && params[0] > 0 ? params[0] - 1 : 0;
+			col = numParams > 1 && params[1] > 0 ? params[1] - 1 : 0;
+			if (row >= VGA_HEIGHT) row = VGA_HEIGHT - 1;
+			if (col >= VGA_WIDTH) col = VGA_WIDTH - 1;
+			break;
+		case 'K':
+			vga_blank(row, col, VGA_WIDTH);
+			break;
+		case 'J':
+			if (numParams > 0 && params[0] == 2) {
+				for (r = 0; r < VGA_HEIGHT; r++)
+					vga_blank(r, 0, VGA_WIDTH);
+				row = 0;
+				col = 0;
+			} else {
+				vga_blank(row, col, VGA_WIDTH);
+				for (r = row + 1; r < VGA_HEIGHT; r++)
+					vga_blank(r, 0, VGA_WIDTH);
+			}
+			break;
+		case '@':
+			if (n > VGA_WIDTH - col) n = VGA_WIDTH - col;
+			memmove(line + col + n, line + col, (VGA_WIDTH - col - n) * sizeof(u16int));
+			vga_blank(row, col, col + n);
+			break;
+		case 'P':
+			if (n > VGA_WIDTH - col) n = VGA_WIDTH - col;
+			memmove(line + col, line + col + n, (VGA_WIDTH - col - n) * sizeof(u16int));
+			vga_blank(row, VGA_WIDTH - n, VGA_WIDTH);
+			break;
+		case 'm':
+			vga_sgr();
+			break;
+	}
+}
+
+/**
+ * Handles one character.
+ *
+ * @param c The character
+ */
+void vga_putc(char c) {
+	if (escState == ESC_SEEN) {
+		if (c == '[') {
+			escState = ESC_CSI;
+			numParams = 0;
+			params[0] = 0;
+		} else {
+			escState = ESC_NONE;
+		}
+		return;
+	}
+	if (escState == ESC_CSI) {
+		if (c >= '0' && c <= '9') {
+			if (numParams == 0) numParams = 1;
+			params[numParams - 1] = params[numParams - 1] * 10 + c - '0';
+		} else if (c == ';') {
+			if (numParams == 0) numParams = 1;
+			if (numParams < VGA_MAX_PARAMS) params[numParams++] = 0;
+		} else {
+			escState = ESC_NONE;
+			vga_csi(c);
+		}
+		return;
+	}
+
+	switch (c) {
+		case '\033':
+			escState = ESC_SEEN;
+			break;
+		case '\n':
+			vga_newline();
+			break;
+		case '\r':
+			col = 0;
+			break;
+		case '\b':
+			if (col > 0) col--;
+			break;
+		case '\t':
+			col = (col + 8) & ~7;
+			if (col >= VGA_WIDTH) vga_newline();
+			break;
+		default:
+			screen[row * VGA_WIDTH + col] = (attr << 8) | (u8int) c;
+			if (++col == VGA_WIDTH) vga_newline();
+			break;
+	}
+}
+
+/**
+ * Writes characters to the screen. Understands \b \r \n \t and these
+ * escape sequences: cursor movement (ESC[nA ESC[nB ESC[nC ESC[nD and
+ * ESC[r;cH), erase in line (ESC[K), erase in display (ESC[J, ESC[2J),
+ * insert and delete characters (ESC[n@ ESC[nP) and colours (ESC[...m).
+ * The hardware cursor is moved once, at the end.
+ *
+ * @param buf The characters
+ * @param len The number of characters
+ */
+void vga_write(const char *buf, int len) {
+	int i;
+	for (i = 0; i < len; i++)
+		vga_putc(buf[i]);
+	vga_move_cursor();
+}
@@ -0,0 +1,186 @@
+/*
+  ----- virtio.c -----
+
+  Description..: Console output over a legacy virtio-pci console.
+	  Writes are copied into transmit buffers and handed to the host
+	  through the transmit virtqueue; finished buffers are reclaimed
+	  from the used ring the next time one is needed. There is no
+	  receive queue and no interrupt: input stays on the serial port.
+*/
+
+#include <string.h>
+#include <system.h>
+
+#include <core/io.h>
+#include <core/klog.h>
+#include <core/pci.h>
+#include <core/virtio.h>
+#include <modules/mpx_supt.h>
+
+// Queue memory: descriptors, then the available ring, then the used ring
+// on the next page. The kernel image is identity mapped, so these
+// addresses are also the physical addresses the device is given.
+static u8int queueMem[3 * VIRTIO_PAGE_SIZE] __attribute__ ((aligned (VIRTIO_PAGE_SIZE)));
+static char txBuffers[VIRTIO_TX_BUFFERS][VIRTIO_TX_BUFFER_SIZE];
+
+static virtqueue txq;
+static u16int iobase = 0;
+static int ready = 0;
+static u32int sent = 0;
+
+/**
+ * Sets up the transmit queue in queueMem and gives it to the device.
+ *
+ * @return True if the device's queue fits
+ */
+int virtio_setup_tx() {
+	u32int availEnd;
+	int i;
+
+	outw(iobase + VIRTIO_QUEUE_SELECT, VIRTIO_CONSOLE_TX);
+	txq.size = inw(iobase + VIRTIO_QUEUE_SIZE);
+	if (txq.size == 0 || txq.size > VIRTIO_MAX_QUEUE)
+		return 0;
+
+	memset(queueMem, 0, sizeof(queueMem));
+	txq.desc = (virtq_desc *) queueMem;
+	txq.avail = (virtq_avail *) (queueMem + 16 * txq.size);
+	availEnd = 16 * txq.size + 6 + 2 * txq.size;
+	txq.used = (virtq_used *) (queueMem + ((availEnd + VIRTIO_PAGE_SIZE - 1) & ~(VIRTIO_PAGE_SIZE - 1)));
+	txq.lastUsed = 0;
+	txq.avail->flags = VIRTQ_AVAIL_F_NO_INTERRUPT; //used buffers are polled for
+
+	//one descriptor per transmit buffer, chained into a free list
+	txq.numFree = txq.size < VIRTIO_TX_BUFFERS ? txq.size : VIRTIO_TX_BUFFERS;
+	for (i = 0; i < txq.numFree; i++) {
+		txq.desc[i].addr = (u32int) txBuffers[i];
+		txq.desc[i].next = i + 1;
+	}
+	txq.freeHead = 0;
+
+	outl(iobase + VIRTIO_QUEUE_PFN, (u32int) queueMem / VIRTIO_PAGE_SIZE);
+	return 1;
+}
+
+/**
+ * Finds a virtio console on the PCI bus and brings it up.
+ *
+ * @return True if a console is ready for output
+ */
+int virtio_console_init() {
+	pci_device *dev = pci_find(VIRTIO_VENDOR, VIRTIO_CONSOLE_DEVICE);
+
+	ready = 0;
+	if (dev == NULL)
+		return 0;
+	if (!(dev->bar[0] & PCI_BAR_IO)) {
+		klog(KLOG_CORE, KLOG_WARN, "virtio console has no I/O BAR");
+		return 0;
+	}
+	iobase = dev->bar[0] & ~0x3;
+	pci_enable(dev);
+
+	outb(iobase + VIRTIO_DEVICE_STATUS, 0); //reset
+	outb(iobase + VIRTIO_DEVICE_STATUS, VIRTIO_STATUS_ACKNOWLEDGE);
+	outb(iobase + VIRTIO_DEVICE_STATUS, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+	outl(iobase + VIRTIO_GUEST_FEATURES, 0); //no multiport: port 0 only
+
+	if (!virtio_setup_tx()) {
+		outb(iobase + VIRTIO_DEVICE_STATUS, VIRTIO_STATUS_FAILED);
+		klog(KLOG_CORE, KLOG_WARN, "virtio console queue is too large");
+		return 0;
+	}
+
+	outb(iobase + VIRTIO_DEVICE_STATUS,
+			VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER | VIRTIO_STATUS_DRIVER_OK);
+	ready = 1;
+	klog(KLOG_CORE, KLOG_INFO, "virtio console ready");
+	return 1;
+}
+
+/**
+ * Tests if the virtio console was found and brought up.
+ *
+ * @return True if it is ready
+ */
+int virtio_console_ready() {
+	return ready;
+}
+
+/**
+ * Puts the descriptors the device has finished with back on the free list.
+ */
+void virtio_reclaim() {
+	u16int id;
+	while (txq.lastUsed != txq.used->idx) {
+		asm volatile ("" ::: "memory"); //index before the ring entry
+		id = txq.used->ring[txq.lastUsed % txq.size].id;
+		txq.desc[id].next = txq.freeHead;
+		txq.freeHead = id;
+		txq.numFree++;
+		txq.lastUsed++;
+	}
+}
+
+/**
+ * Writes characters to the host through the virtio console. Waits only
+ * when every transmit buffer is still held by the device, and gives the
+ * console up if none comes back within VIRTIO_TX_SPIN pauses.
+ *
+ * @param buf The characters
+ * @param len The number of characters
+ * @return The number written; less than len if the console is not ready
+ *         or was given up
+ */
+int virtio_console_write(const char *buf, int len) {
+	int was_on = irq_on();
+	int done = 0, spin = 0, chunk, i;
+	u16int id;
+
+	if (!ready)
+		return 0;
+
+	cli();
+	while (done < len) {
+		virtio_reclaim();
+		if (txq.numFree == 0) {
+			if (++spin < VIRTIO_TX_SPIN) {
+				asm volatile ("pause");
+				continue;
+			}
+			ready = 0; //the host stopped taking output
+			break;
+		}
+		spin = 0;
+
+		chunk = len - done > VIRTIO_TX_BUFFER_SIZE ? VIRTIO_TX_BUFFER_SIZE : len - done;
+		id = txq.freeHead;
+		txq.freeHead = txq.desc[id].next;
+		txq.numFree--;
+		for (i = 0; i < chunk; i++)
+			txBuffers[id][i] = buf[done + i];
+		txq.desc[id].len = chunk;
+		txq.desc[id].flags = 0;
+
+		txq.avail->ring[txq.avail->idx % txq.size] = id;
+		asm volatile ("" ::: "memory"); //ring entry before the index
+		txq.avail->idx++;
+		asm volatile ("" ::: "memory");
+		outw(iobase + VIRTIO_QUEUE_NOTIFY, VIRTIO_CONSOLE_TX);
+		done += chunk;
+	}
+	sent += done;
+	if (was_on) sti();
+	if (!ready)
+		klog(KLOG_CORE, KLOG_WARN, "virtio console stalled; using COM1");
+	return done;
+}
+
+/**
+ * Gets the number of bytes sent through the virtio console.
+ *
+ * @return The number of bytes
+ */
+u32int virtio_console_sent() {
+	return sent;
+}
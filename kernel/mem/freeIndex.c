@@ -0,0 +1,294 @@
+/**
+ * Size index over the R5 heap's free blocks. The links live in the free blocks' cmcbs, so the
+ * index needs no memory of its own. The size tree is an AVL tree, keeping best-fit lookups,
+ * inserts and removals all O(log n).
+ */
+#include <system.h>
+#include <boolean.h>
+#include <mem/memoryControl.h>
+#include <mem/freeIndex.h>
+
+cmcb *sizeTree;
+cmcb *fastBins[FAST_BINS];
+u32int binMap; //bit i is set when fast bin i is not empty
+
+/**
+ * Private helper function to get the height of a subtree
+ *
+ * @param node - root of the subtree, may be NULL
+ * @return height, 0 for an empty subtree
+ */
+int _height(cmcb *node){
+	return node == NULL ? 0 : node->height;
+}
+
+/**
+ * Private helper function to recompute a node's height from its children
+ *
+ * @param node - the node
+ */
+void _updateHeight(cmcb *node){
+	int left = _height(node->left);
+	int right = _height(node->right);
+	node->height = (left > right ? left : right) + 1;
+}
+
+/**
+ * Private helper function to put a node where another one hung from its parent
+ *
+ * @param parent - parent of the old node, NULL if it was the root
+ * @param old - the node being replaced
+ * @param node - the node taking its place, may be NULL
+ */
+void _replaceChild(cmcb *parent, cmcb *old, cmcb *node){
+	if (parent == NULL){
+		sizeTree = node;
+	}
+	else if (parent->left == old){
+		parent->left = node;
+	}
+	else {
+		parent->right = node;
+	}
+	if (node != NULL){
+		node->parent = parent;
+	}
+}
+
+/**
+ * Private helper function to rotate a subtree left
+ *
+ * @param node - root of the subtree
+ * @return the new root of the subtree
+ */
+cmcb *_rotateLeft(cmcb *node){
+	cmcb *right = node->right;
+
+	node->right = right->left;
+	if (right->left != NULL){
+		right->left->parent = node;
+	}
+	_replaceChild(node->parent, node, right);
+	right->left = node;
+	node->parent = right;
+
+	_updateHeight(node);
+	_updateHeight(right);
+	return right;
+}
+
+/**
+ * Private helper function to rotate a subtree right
+ *
+ * @param node - root of the subtree
+ * @return the new root of the subtree
+ */
+cmcb *_rotateRight(cmcb *node){
+	cmcb *left = node->left;
+
+	node->left = left->right;
+	if (left->right != NULL){
+		left->right->parent = node;
+	}
+	_replaceChild(node->parent, node, left);
+	left->right = node;
+	node->parent = left;
+
+	_updateHeight(node);
+	_updateHeight(left);
+	return left;
+}
+
+/**
+ * Private helper function to restore the AVL balance from a node up to the root
+ *
+ * @param node - lowest node whose subtree changed, may be NULL
+ */
+void _rebalance(cmcb *node){
+	while (node != NULL){
+		_updateHeight(node);
+		int balance = _height(node->left) - _height(node->right);
+
+		if (balance > 1){ //left heavy
+			if (_height(node->left->left) < _height(node->left->right)){
+				_rotateLeft(node->left);
+			}
+			node = _rotateRight(node);
+		}
+		else if (balance < -1){ //right heavy
+			if (_height(node->right->right) < _height(node->right->left)){
+				_rotateRight(node->right);
+			}
+			node = _rotateLeft(node);
+		}
+		node = node->parent;
+	}
+}
+
+/**
+ * Private helper function to insert a block into the size tree
+ *
+ * @param block - the free block
+ */
+void _treeInsert(cmcb *block){
+	cmcb *parent = NULL;
+	cmcb *node = sizeTree;
+	while (node != NULL){ //ordered by size, then address so every key is unique
+		parent = node;
+		if (block->size < node->size || (block->size == node->size && block < node)){
+			node = node->left;
+		}
+		else {
+			node = node->right;
+		}
+	}
+
+	block->left = NULL;
+	block->right = NULL;
+	block->height = 1;
+	block->parent = parent;
+	if (parent == NULL){
+		sizeTree = block;
+	}
+	else if (block->size < parent->size || (block->size == parent->size && block < parent)){
+		parent->left = block;
+	}
+	else {
+		parent->right = block;
+	}
+	_rebalance(parent);
+}
+
+/**
+ * Private helper function to remove a block from the size tree
+ *
+ * @param block - the free block
+ */
+void _treeRemove(cmcb *block){
+	if (block->left != NULL && block->right != NULL){ //swap in the next larger block
+		cmcb *successor = block->right;
+		while (successor->left != NULL){
+			successor = successor->left;
+		}
+
+		cmcb *start = successor;
+		if (successor->parent != block){ //take it out from deeper in the right subtree
+			start = successor->parent;
+			_replaceChild(successor->parent, successor, successor->right);
+			successor->right = block->right;
+			successor->right->parent = successor;
+		}
+		_replaceChild(block->parent, block, successor);
+		successor->left = block->left;
+		successor->left->parent = successor;
+		successor->height = block->height;
+		_rebalance(start);
+	}
+	else {
+		cmcb *child = block->left != NULL ? block->left : block->right;
+		cmcb *parent = block->parent;
+		_replaceChild(parent, block, child);
+		_rebalance(parent);
+	}
+
+	block->left = NULL;
+	block->right = NULL;
+	block->parent = NULL;
+}
+
+/**
+ * Adds a free block to the fast bins or the size tree
+ *
+ * @param block - the free block
+ */
+void indexFree(cmcb *block){
+	if (block->size >= FREE_TREE_MIN){
+		_treeInsert(block);
+		return;
+	}
+
+	int bin = block->size / FAST_BIN_SPACING;
+	block->parent = NULL;
+	block->left = NULL;
+	block->right = fastBins[bin];
+	if (fastBins[bin] != NULL){
+		fastBins[bin]->left = block;
+	}
+	fastBins[bin] = block;
+	binMap |= (u32int)1 << bin;
+}
+
+/**
+ * Removes a free block from the fast bins or the size tree. The block's size must not have
+ * changed since it was indexed.
+ *
+ * @param block - the free block
+ */
+void unindexFree(cmcb *block){
+	if (block->size >= FREE_TREE_MIN){
+		_treeRemove(block);
+		return;
+	}
+
+	int bin = block->size / FAST_BIN_SPACING;
+	if (block->left != NULL){
+		block->left->right = block->right;
+	}
+	else {
+		fastBins[bin] = block->right;
+	}
+	if (block->right != NULL){
+		block->right->left = block->left;
+	}
+	if (fastBins[bin] == NULL){
+		binMap &= ~((u32int)1 << bin);
+	}
+	block->left = NULL;
+	block->right = NULL;
+}
+
+/**
+ * Finds a free block for a request. Small requests take the first block that fits from the
+ * smallest fast bin that has one; larger ones take the smallest block in the tree that fits.
+ *
+ * @param trueSize - size of the block needed, including structs
+ * @return cmcb * to the free block, or NULL if none fit
+ */
+cmcb *findFreeFit(int trueSize){
+	if (trueSize < FREE_TREE_MIN){
+		int bin = trueSize / FAST_BIN_SPACING;
+		cmcb *node;
+		for (node = fastBins[bin]; node != NULL; node = node->right){ //sizes in a bin differ by less than the spacing
+			if (node->size >= trueSize){
+				return node;
+			}
+		}
+
+		u32int larger = binMap & ~(((u32int)2 << bin) - 1); //every block in a larger bin fits
+		if (larger != 0){
+			return fastBins[__builtin_ctzl(larger)];
+		}
+	}
+
+	cmcb *best = NULL;
+	cmcb *node = sizeTree;
+	while (node != NULL){
+		if (node->size >= trueSize){
+			best = node;
+			node = node->left;
+		}
+		else {
+			node = node->right;
+		}
+	}
+	return best;
+}
+
+/**
+ * Returns the root of the size tree
+ *
+ * @return cmcb * to the root, or NULL if the tree is empty
+ */
+cmcb *getSizeTree(){
+	return sizeTree;
+}
@@ -69,8 +69,173 @@ u32int kmalloc(u32int size) {
 	return _kmalloc(size, 0, 0);
 }
 
+/**
+ * Returns the footer of a block.
+ *
+ * @param block The block header
+ * @return The block footer
+ */
+static footer *_block_footer(header *block) {
+	return (footer *) ((u32int) block + block->size - sizeof(footer));
+}
+
+/**
+ * Writes the header and footer of a block.
+ *
+ * @param block The block header
+ * @param size The block size, including header and footer
+ * @param index_id The index slot, or KHEAP_USED
+ */
+static void _write_block(header *block, u32int size, int index_id) {
+	footer *foot;
+
+	block->magic = KHEAP_MAGIC;
+	block->size = size;
+	block->index_id = index_id;
+	foot = _block_footer(block);
+	foot->head.magic = KHEAP_MAGIC;
+	foot->head.size = size;
+	foot->head.index_id = KHEAP_USED;
+}
+
+/**
+ * Adds a hole to the heap index, keeping the table sorted by size.
+ *
+ * @param h The heap
+ * @param block The hole
+ * @return 1 if the hole was indexed, 0 if the index is full
+ */
+static int _index_insert(heap *h, header *block) {
+	index_table *index = &h->index;
+	int i;
+
+	if (index->id >= TABLE_SIZE) {
+		block->index_id = KHEAP_USED;
+		return 0;
+	}
+
+	//shift the larger holes up a slot
+	for (i = index->id; i > 0 && index->table[i - 1].size > block->size; i--) {
+		index->table[i] = index->table[i - 1];
+		((header *) index->table[i].block)->index_id = i;
+	}
+
+	index->table[i].size = block->size;
+	index->table[i].empty = 0;
+	index->table[i].block = (u32int) block;
+	block->index_id = i;
+	index->id++;
+	return 1;
+}
+
+/**
+ * Removes a hole from the heap index.
+ *
+ * @param h The heap
+ * @param block The hole
+ */
+static void _index_remove(heap *h, header *block) {
+	index_table *index = &h->index;
+	int i;
+
+	for (i = block->index_id; i < index->id - 1; i++) {
+		index->table[i] = index->table[i + 1];
+		((header *) index->table[i].block)->index_id = i;
+	}
+
+	index->id--;
+	index->table[index->id].empty = 1;
+	block->index_id = KHEAP_USED;
+}
+
+/**
+ * Finds the smallest hole that can hold a block.
+ *
+ * @param h The heap
+ * @param need The block size, including header and footer
+ * @param align Whether the block data must be page aligned
+ * @param lead Set to the gap to split off before an aligned block
+ * @return The hole, or 0 if none fits
+ */
+static header *_find_hole(heap *h, u32int need, int align, u32int *lead) {
+	index_table *index = &h->index;
+	int lo = 0, hi = index->id, i;
+
+	//binary search for the first hole that is large enough
+	while (lo < hi) {
+		i = (lo + hi) / 2;
+		if ((u32int) index->table[i].size < need) lo = i + 1;
+		else hi = i;
+	}
+
+	for (i = lo; i < index->id; i++) {
+		u32int gap = 0;
+		u32int data = index->table[i].block + sizeof(header);
+
+		if (align && (data & 0xFFF)) {
+			//the gap must be large enough to stay behind as a hole
+			gap = PAGE_SIZE - (data & 0xFFF);
+			if (gap < KHEAP_MIN_HOLE) gap += PAGE_SIZE;
+		}
+		if ((u32int) index->table[i].size >= gap + need) {
+			*lead = gap;
+			return (header *) index->table[i].block;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Grows a heap by mapping new pages at its end. The new space is joined
+ * with the last block if that is a hole.
+ *
+ * @param h The heap
+ * @param size The minimum number of bytes to add
+ * @return 1 on success, 0 if the heap is at its maximum size or its
+ *         index is full
+ */
+static int _expand(heap *h, u32int size) {
+	u32int old_end = h->end;
+	u32int new_end = (old_end + size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+	header *block = (header *) old_end;
+	u32int addr;
+
+	if (new_end > h->base + h->max_size)
+		return 0;
+
+	//page tables for the heap range are created in init_paging
+	for (addr = old_end; addr < new_end; addr += PAGE_SIZE)
+		new_frame(get_page(addr, kdir, 0));
+	h->end = new_end;
+
+	if (old_end > h->base) {
+		footer *foot = (footer *) (old_end - sizeof(footer));
+		header *last = (header *) (old_end - foot->head.size);
+		if (last->magic == KHEAP_MAGIC && last->index_id != KHEAP_USED) {
+			_index_remove(h, last);
+			block = last;
+		}
+	}
+
+	_write_block(block, new_end - (u32int) block, KHEAP_USED);
+	if (!_index_insert(h, block)) {
+		//no hole could be found in the new space, so give it back; only a
+		//new block gets here, as joining the last hole freed its entry
+		serial_println("Heap index is full!");
+		for (addr = old_end; addr < new_end; addr += PAGE_SIZE) {
+			free_frame(get_page(addr, kdir, 0));
+			invalidate_page(addr);
+		}
+		h->end = old_end;
+		return 0;
+	}
+	return 1;
+}
+
 /**
  * Allocates some memory using the given heap. Can specify page-alignment.
+ * The heap is expanded up to its maximum size when no hole fits.
  *
  * @param size The amount of memory to allocate
  * @param hp The heap to allocate on
@@ -78,27 +243,115 @@ u32int kmalloc(u32int size) {
  * @return The memory address
  */
 u32int alloc(u32int size, heap *h, int align) {
-	no_warn(size || align || h);
-	static u32int heap_addr = KHEAP_BASE;
+	u32int need = ((size + 3) & ~3) + sizeof(header) + sizeof(footer);
+	u32int lead = 0, hole_size;
+	header *hole;
+
+	while (!(hole = _find_hole(h, need, align, &lead))) {
+		if (!_expand(h, need + (align ? 2 * PAGE_SIZE : 0))) {
+			serial_println("Heap is full!");
+			return 0;
+		}
+	}
+
+	_index_remove(h, hole);
+	hole_size = hole->size;
+
+	//leave the gap before an aligned block behind as a hole
+	if (lead) {
+		_write_block(hole, lead, KHEAP_USED);
+		if (!_index_insert(h, hole))
+			serial_println("Heap index is full!");
+		hole = (header *) ((u32int) hole + lead);
+		hole_size -= lead;
+	}
 
-	u32int base = heap_addr;
-	heap_addr += size;
+	//split off the unused tail
+	if (hole_size - need >= KHEAP_MIN_HOLE) {
+		header *rest = (header *) ((u32int) hole + need);
+		_write_block(rest, hole_size - need, KHEAP_USED);
+		if (_index_insert(h, rest))
+			hole_size = need;
+	}
+
+	_write_block(hole, hole_size, KHEAP_USED);
+	return (u32int) hole + sizeof(header);
+}
+
+/**
+ * Free kernel memory. The block is merged with any neighbouring holes and
+ * returned to the heap index. Memory handed out before the kernel heap was
+ * created is never freed.
+ *
+ * @param addr The address returned by kmalloc
+ */
+void kfree(u32int addr) {
+	header *block, *next;
+	u32int size;
+
+	if (!kheap || addr < kheap->base + sizeof(header) || addr >= kheap->end)
+		return;
+
+	block = (header *) (addr - sizeof(header));
+	if (block->magic != KHEAP_MAGIC || block->index_id != KHEAP_USED) {
+		serial_println("kfree: bad block");
+		return;
+	}
+	size = block->size;
 
-	if (heap_addr > KHEAP_BASE + KHEAP_MIN)
-		serial_println("Heap is full!");
+	//merge with the following hole
+	next = (header *) ((u32int) block + size);
+	if ((u32int) next < kheap->end && next->magic == KHEAP_MAGIC && next->index_id != KHEAP_USED) {
+		_index_remove(kheap, next);
+		size += next->size;
+	}
 
-	return base;
+	//merge with the preceding hole
+	if ((u32int) block > kheap->base) {
+		footer *foot = (footer *) ((u32int) block - sizeof(footer));
+		header *prev = (header *) ((u32int) block - foot->head.size);
+		if (foot->head.magic == KHEAP_MAGIC && prev->magic == KHEAP_MAGIC && prev->index_id != KHEAP_USED) {
+			_index_remove(kheap, prev);
+			size += prev->size;
+			block = prev;
+		}
+	}
+
+	_write_block(block, size, KHEAP_USED);
+	if (!_index_insert(kheap, block))
+		serial_println("Heap index is full!");
 }
 
 /**
  * Create a new heap.
  *
- * @param base Physical start address of the heap
+ * @param base Start address of the heap; the first min bytes must be mapped
  * @param max Maximum size the heap may grow to
  * @param min Minium/Initial size
  * @return The address of the heap
  */
 heap *make_heap(u32int base, u32int max, u32int min) {
-	no_warn(base || max || min);
-	return (heap *) kmalloc(sizeof(heap));
+	heap *h = (heap *) kmalloc(sizeof(heap));
+	int i;
+
+	for (i = 0; i < TABLE_SIZE; i++)
+		h->index.table[i].empty = 1;
+	h->index.id = 0;
+	h->base = base;
+	h->end = base + min;
+	h->max_size = max;
+	h->min_size = min;
+
+	//the whole initial area starts as one hole
+	_write_block((header *) base, min, KHEAP_USED);
+	_index_insert(h, (header *) base);
+	return h;
+}
+
+/**
+ * Initialize the kernel heap, and set it as the current heap.
+ */
+void init_kheap() {
+	kheap = make_heap(KHEAP_BASE, KHEAP_SIZE, KHEAP_MIN);
+	curr_heap = kheap;
 }
@@ -0,0 +1,325 @@
+/**
+ * Allocation site profiler for the R5 heap. Every live block is looked up in a fixed hash table
+ * kept outside the heap, so turning profiling on does not change the heap being profiled.
+ */
+#include <system.h>
+#include <boolean.h>
+#include <mem/memoryControl.h>
+#include <mem/heapProfile.h>
+#include <core/serial.h>
+#include <string.h>
+
+boolean profiling = false;
+boolean tracing = false;
+int traceDevice = 0; //0 for the console
+u32int profileStart;
+u32int profileStop;
+int profileDropped;
+int siteCount;
+int recordCount;
+allocSite sites[PROFILE_SITES];
+profileRecord records[PROFILE_BLOCKS]; //open addressing with linear probing
+
+/**
+ * Private helper function to get the home slot of a block in the record table
+ *
+ * @param block - the block
+ * @return index into records
+ */
+int _recordSlot(cmcb *block){
+	u32int key = (u32int)block >> 4; //blocks are at least 16 bytes apart
+	return (int)((key * 2654435761u) >> 8) & (PROFILE_BLOCKS - 1);
+}
+
+/**
+ * Private helper function to find the record of a block
+ *
+ * @param block - the block
+ * @return index into records, or -1 if the block is not recorded
+ */
+int _findRecord(cmcb *block){
+	int slot = _recordSlot(block);
+	int probes;
+	for (probes = 0; probes < PROFILE_BLOCKS; probes++){
+		if (records[slot].block == block){
+			return slot;
+		}
+		if (records[slot].block == NULL){
+			return -1;
+		}
+		slot = (slot + 1) & (PROFILE_BLOCKS - 1);
+	}
+	return -1;
+}
+
+/**
+ * Private helper function to find or add the site for a pair of return addresses
+ *
+ * @param caller - return address into the code that called the heap
+ * @param callerParent - return address one frame further up
+ * @return allocSite *, or NULL if the site table is full
+ */
+allocSite *_findSite(void *caller, void *callerParent){
+	int i;
+	for (i = 0; i < siteCount; i++){
+		if (sites[i].caller == caller && sites[i].callerParent == callerParent){
+			return &sites[i];
+		}
+	}
+	if (siteCount == PROFILE_SITES){
+		return NULL;
+	}
+
+	allocSite *site = &sites[siteCount++];
+	site->caller = caller;
+	site->callerParent = callerParent;
+	site->liveBytes = 0;
+	site->liveBlocks = 0;
+	site->allocations = 0;
+	return site;
+}
+
+/**
+ * Turns profiling on or off. Turning it on clears anything recorded before.
+ *
+ * @param on - true to start recording allocations
+ */
+void setProfiling(boolean on){
+	if (on){
+		int i;
+		for (i = 0; i < PROFILE_BLOCKS; i++){
+			records[i].block = NULL;
+		}
+		siteCount = 0;
+		recordCount = 0;
+		profileDropped = 0;
+		profileStart = rdtsc();
+	}
+	else if (profiling){
+		profileStop = rdtsc();
+	}
+	profiling = on;
+}
+
+/**
+ * Returns whether allocations are being recorded
+ *
+ * @return boolean
+ */
+boolean isProfiling(){
+	return profiling;
+}
+
+/**
+ * Records a new allocation
+ *
+ * @param block - the allocated block
+ * @param frame - frame of the outermost heap function called, its return address is the site
+ */
+void profileAlloc(cmcb *block, void **frame){
+	void *caller = frame[1];
+	void *callerParent = NULL;
+
+	//only follow the saved frame pointer if it looks like it is further up the same stack
+	void **parentFrame = (void**)frame[0];
+	if (parentFrame > frame && (void*)parentFrame < (void*)frame + 0x10000){
+		callerParent = parentFrame[1];
+	}
+
+	allocSite *site = _findSite(caller, callerParent);
+	if (site == NULL){
+		profileDropped++;
+		return;
+	}
+	site->allocations++;
+
+	if (recordCount >= PROFILE_BLOCKS * 3 / 4){ //keep empty slots so probe runs stay short and end
+		profileDropped++;
+		return;
+	}
+
+	int slot = _recordSlot(block);
+	while (records[slot].block != NULL){
+		slot = (slot + 1) & (PROFILE_BLOCKS - 1);
+	}
+	recordCount++;
+
+	records[slot].block = block;
+	records[slot].site = site;
+	records[slot].time = rdtsc();
+	records[slot].size = block->size;
+	site->liveBytes += block->size;
+	site->liveBlocks++;
+}
+
+/**
+ * Updates the recorded size of a block that was resized in place
+ *
+ * @param block - the allocated block
+ */
+void profileResize(cmcb *block){
+	if (recordCount == 0){ //nothing recorded, or profiling was never on
+		return;
+	}
+	int slot = _findRecord(block);
+	if (slot < 0){
+		return;
+	}
+	records[slot].site->liveBytes += block->size - records[slot].size;
+	records[slot].size = block->size;
+}
+
+/**
+ * Forgets a block that is being freed
+ *
+ * @param block - the allocated block
+ */
+void profileFree(cmcb *block){
+	if (recordCount == 0){ //nothing recorded, or profiling was never on
+		return;
+	}
+	int slot = _findRecord(block);
+	if (slot < 0){ //allocated before profiling started, or dropped
+		return;
+	}
+	records[slot].site->liveBytes -= records[slot].size;
+	records[slot].site->liveBlocks--;
+	recordCount--;
+
+	//shift later records of the same probe run back so lookups never stop at the hole
+	int hole = slot;
+	int next = (slot + 1) & (PROFILE_BLOCKS - 1);
+	while (records[next].block != NULL){
+		int home = _recordSlot(records[next].block);
+		if (((next - home) & (PROFILE_BLOCKS - 1)) >= ((next - hole) & (PROFILE_BLOCKS - 1))){
+			records[hole] = records[next];
+			hole = next;
+		}
+		next = (next + 1) & (PROFILE_BLOCKS - 1);
+	}
+	records[hole].block = NULL;
+}
+
+/**
+ * Returns the table of allocation sites
+ *
+ * @param count - set to the number of sites in use
+ * @return allocSite * to the first site
+ */
+allocSite *getProfileSites(int *count){
+	*count = siteCount;
+	return sites;
+}
+
+/**
+ * Returns the live block records, indexed by a hash of the block address
+ *
+ * @return profileRecord * to an array of PROFILE_BLOCKS records
+ */
+profileRecord *getProfileRecords(){
+	return records;
+}
+
+/**
+ * Returns the number of cycles profiling has been on for
+ *
+ * @return cycles since profiling was turned on, or until it was turned off
+ */
+u32int getProfileCycles(){
+	u32int end = profiling ? rdtsc() : profileStop;
+	return (end - profileStart) & 0xFFFFFFFF;
+}
+
+/**
+ * Returns the number of allocations that could not be recorded because a table was full
+ *
+ * @return number of allocations missed
+ */
+int getProfileDropped(){
+	return profileDropped;
+}
+
+/**
+ * Turns allocation tracing on or off. While on, every allocation and free is written to the
+ * serial port as a record tools/heapbench can replay:
+ *	HT a <id> <size>
+ *	HT f <id>
+ * The id is the block's address, so it is unique among live blocks.
+ *
+ * @param on - true to start writing records
+ */
+void setTracing(boolean on){
+	tracing = on;
+}
+
+/**
+ * Returns whether allocations are being traced
+ *
+ * @return boolean
+ */
+boolean isTracing(){
+	return tracing;
+}
+
+/**
+ * Sends trace records to their own serial port instead of the console
+ *
+ * @param device - the port, or 0 for the console
+ */
+void setTraceDevice(int device){
+	traceDevice = device;
+}
+
+/**
+ * Gets the port trace records are sent to
+ *
+ * @return the port, or 0 for the console
+ */
+int getTraceDevice(){
+	return traceDevice;
+}
+
+/**
+ * Private helper function to write one trace record to the trace port
+ *
+ * @param record - the record, without the line ending
+ */
+void _traceWrite(char *record){
+	strcat(record, "\r\n");
+	if (traceDevice == 0){
+		serial_print(record);
+	} else {
+		serial_write_device(traceDevice, record, strlen(record));
+	}
+}
+
+/**
+ * Writes the trace record of a new allocation
+ *
+ * @param block - the allocated block
+ */
+void traceAlloc(cmcb *block){
+	char record[40] = "HT a ";
+	char num[11];
+
+	itoa((int)(u32int)block, num, 10);
+	strcat(record, num);
+	strcat(record, " ");
+	itoa(block->memSize, num, 10);
+	strcat(record, num);
+	_traceWrite(record);
+}
+
+/**
+ * Writes the trace record of a free
+ *
+ * @param block - the block being freed
+ */
+void traceFree(cmcb *block){
+	char record[40] = "HT f ";
+	char num[11];
+
+	itoa((int)(u32int)block, num, 10);
+	strcat(record, num);
+	_traceWrite(record);
+}
@@ -2,17 +2,37 @@
 // Created by djbowman on 4/8/17.
 //
 #include <system.h>
+#include <core/klog.h>
+#include <core/ktrace.h>
 #include <mem/heap.h>
+#include <mem/paging.h>
 #include <mem/memoryControl.h>
+#include <mem/heapProfile.h>
+#include <mem/freeIndex.h>
 #include <modules/mpx_supt.h>
 #include <boolean.h>
 
-cmcb *freeHead;
+extern page_dir *kdir; //kernel page directory; defined in paging.c
+
+cmcb *freeHead; //every free block, most recently freed first; searches go through freeIndex.c
 cmcb *allocatedHead;
-void *memHeap;
+void *memHeap; //start of the heap's virtual range
+void *heapBreak; //end of the mapped part of the heap
 int isInitialized = false;
-int memSize;
+int memSize; //bytes currently mapped between memHeap and heapBreak
+int minHeapSize; //the heap never shrinks below its initial size
 int memAllocated;
+memAccount kernelAccount; //usage of allocations made while no process was running
+latencyLog allocLatency;
+latencyLog freeLatency;
+void **callerFrame; //frame of the outermost heap function being run, for the profiler
+int layoutChanges; //bumped whenever block structs are placed, so the guard sweep can restart
+guardReport guard;
+int guardCountdown; //allocations until the next guarded one
+cmcb *quarantine[HEAP_QUARANTINE]; //oldest first from quarantineHead
+int quarantineHead;
+void *sweepCursor;
+int sweepChanges;
 
 cmcb *_placeStructs(int size, void *pos, int type, cmcb *prev, cmcb *next);
 
@@ -33,55 +53,526 @@ cmcb *_placeStructs(int size, void *pos, int type, cmcb *prev, cmcb *next){
 	firstCMCB->size = size;
 	firstCMCB->memSize = size - sizeof(struct cmcb) - sizeof(struct lmcb);
 	firstCMCB->name = "FREE";
+	firstCMCB->zeroed = false;
 	firstCMCB->next = next;
 	firstCMCB->prev = prev;
+	firstCMCB->owner = 0;
+	firstCMCB->account = NULL;
+	firstCMCB->ownerNext = NULL;
+	firstCMCB->ownerPrev = NULL;
+	firstCMCB->guardSize = 0;
 
-	lmcb *firstLMCB = (struct lmcb*)(size - sizeof(struct lmcb));
+	lmcb *firstLMCB = (struct lmcb*)(pos + size - sizeof(struct lmcb));
 	firstLMCB->type = type;
 	firstLMCB->size = size;
 	firstLMCB->memSize = size - sizeof(struct cmcb) - sizeof(struct lmcb);
 
+	layoutChanges++;
 	return firstCMCB;
 }
 
 /**
- * Private helper function to merge all adjacent memory blocks
+ * Private helper function to get the size of the block needed to hold a request, including
+ * both control structs, rounded up so every block stays 4-byte aligned
+ *
+ * @param size - requested size in bytes
+ * @return size of the block in bytes
+ */
+int _blockSize(int size){
+	return (size + sizeof(struct cmcb) + sizeof(struct lmcb) + 3) & ~3;
+}
+
+/**
+ * Private helper function to zero a word aligned region a word at a time
  *
+ * @param pos - start of the region
+ * @param bytes - size of the region in bytes
  */
-void _mergeAdjacentFree(){
-	boolean isDoneMerging = false;
-	cmcb* node = freeHead;
+void _zeroWords(void *pos, int bytes){
+	u32int *word = (u32int*)pos;
+	int count = bytes / sizeof(u32int);
+	while (count-- > 0){
+		*word++ = 0;
+	}
+	unsigned char *byte = (unsigned char*)word;
+	count = bytes % sizeof(u32int);
+	while (count-- > 0){ //leftover bytes
+		*byte++ = 0;
+	}
+}
 
-	boolean madeChanges = false;
+/**
+ * Private helper function to copy between word aligned regions a word at a time
+ *
+ * @param dest - start of the destination
+ * @param src - start of the source
+ * @param bytes - number of bytes to copy
+ */
+void _copyWords(void *dest, void *src, int bytes){
+	u32int *to = (u32int*)dest;
+	u32int *from = (u32int*)src;
+	int count = bytes / sizeof(u32int);
+	while (count-- > 0){
+		*to++ = *from++;
+	}
+	unsigned char *toByte = (unsigned char*)to;
+	unsigned char *fromByte = (unsigned char*)from;
+	count = bytes % sizeof(u32int);
+	while (count-- > 0){ //leftover bytes
+		*toByte++ = *fromByte++;
+	}
+}
 
-	while (!isDoneMerging){
-		if (node == NULL){ //end of list
-			if (madeChanges){ //have made changes, need to reloop list
-				madeChanges = false;
-				node = freeHead;
-			}
-			else { //no changes made on this pass, done
-				isDoneMerging = true;
-			}
+/**
+ * Private helper function to release the frames behind a page-aligned part of the heap's virtual range
+ *
+ * @param start - first address to unmap
+ * @param end - address after the last one to unmap
+ */
+void _unmapHeapPages(void *start, void *end){
+	void *addr = start;
+	for (; addr < end; addr += PAGE_SIZE){
+		page_entry *page = get_page((u32int)addr, kdir, 0);
+		if (page != NULL){
+			free_frame(page);
+			invalidate_page((u32int)addr);
 		}
-		else if ((void*)node + node->size == (void*)node->next){ //need merged
-			cmcb *next = node->next->next; //store pertinent info
-			cmcb *prev = node->prev;
-			int trueSize = node->size + node->next->size;
-			 cmcb *newNode = _placeStructs(trueSize, (void*)node, FREE, prev, next); //make new free mem node
-			if (prev != NULL){
-				prev->next = newNode;
-			}
-			if (next != NULL){
-				next->prev = newNode;
-			}
-
-			madeChanges = true;
+	}
+}
+
+/**
+ * Private helper function to add a block to the free list and the size index
+ *
+ * @param block - the free block to insert
+ */
+void _insertFree(cmcb *block){
+	block->prev = NULL;
+	block->next = freeHead;
+	if (freeHead != NULL){
+		freeHead->prev = block;
+	}
+	freeHead = block;
+	indexFree(block);
+}
+
+/**
+ * Private helper function to unlink a block from the list it is in
+ *
+ * @param block - the block to unlink
+ * @param head - head of the list the block is in
+ */
+void _unlinkBlock(cmcb *block, cmcb **head){
+	if (block->prev != NULL){
+		block->prev->next = block->next;
+	}
+	else {
+		*head = block->next;
+	}
+	if (block->next != NULL){
+		block->next->prev = block->prev;
+	}
+	block->next = NULL;
+	block->prev = NULL;
+}
+
+/**
+ * Private helper function to insert a block into the address ordered allocated list
+ *
+ * @param block - the allocated block to insert
+ */
+void _insertAllocated(cmcb *block){
+	block->prev = NULL;
+	block->next = NULL;
+	if (allocatedHead == NULL){
+		allocatedHead = block;
+		return;
+	}
+	if (block < allocatedHead){ //new head
+		block->next = allocatedHead;
+		allocatedHead->prev = block;
+		allocatedHead = block;
+		return;
+	}
+	cmcb *node = allocatedHead;
+	while (node->next != NULL && node->next < block){
+		node = node->next;
+	}
+	block->next = node->next;
+	block->prev = node;
+	if (node->next != NULL){
+		node->next->prev = block;
+	}
+	node->next = block;
+}
+
+/**
+ * Private helper function to take a block out of the free list and the size index
+ *
+ * @param block - the free block to remove
+ */
+void _removeFree(cmcb *block){
+	unindexFree(block);
+	_unlinkBlock(block, &freeHead);
+}
+
+/**
+ * Private helper function to join two physically adjacent free blocks. The result is still
+ * pre-zeroed if both halves were, which only needs the structs that end up inside it cleared.
+ *
+ * @param first - the lower block, not in the free list
+ * @param second - the block directly after it, not in the free list
+ * @return the joined block
+ */
+cmcb *_joinFree(cmcb *first, cmcb *second){
+	boolean zeroed = first->zeroed && second->zeroed;
+	void *seam = (void*)second - sizeof(struct lmcb);
+
+	_placeStructs(first->size + second->size, (void*)first, FREE, NULL, NULL);
+	if (zeroed){ //old lmcb and cmcb are now inside the block
+		_zeroWords(seam, sizeof(struct lmcb) + sizeof(struct cmcb));
+		first->zeroed = true;
+	}
+	return first;
+}
+
+/**
+ * Private helper function to merge a new free block with the free blocks physically next to it
+ * and add the result to the free list. The neighbours are found through the cmcb after the
+ * block and the lmcb before it, so no list is searched.
+ *
+ * @param block - a free block not yet in the free list
+ * @return the merged block
+ */
+cmcb *_mergeAdjacentFree(cmcb *block){
+	cmcb *next = (struct cmcb*)((void*)block + block->size);
+	if ((void*)next < heapBreak && next->type == FREE){ //merge with following block
+		_removeFree(next);
+		_joinFree(block, next);
+	}
+
+	if ((void*)block > memHeap){
+		lmcb *prevEnd = (struct lmcb*)((void*)block - sizeof(struct lmcb));
+		if (prevEnd->type == FREE){ //merge with preceding block
+			cmcb *prev = (struct cmcb*)((void*)block - prevEnd->size);
+			_removeFree(prev);
+			block = _joinFree(prev, block);
 		}
-		else {
-			node = node->next; //iterate
+	}
+
+	_insertFree(block);
+	return block;
+}
+
+/**
+ * Private helper function to get the free block that ends at the heap break, if there is one
+ *
+ * @return cmcb * to the free tail, or NULL if the last block is allocated
+ */
+cmcb *_getFreeTail(){
+	if (heapBreak == memHeap){
+		return NULL;
+	}
+	lmcb *last = (struct lmcb*)(heapBreak - sizeof(struct lmcb));
+	if (last->type != FREE){
+		return NULL;
+	}
+	return (struct cmcb*)(heapBreak - last->size);
+}
+
+/**
+ * Private helper function to grow the heap so a block of the given size fits at its end.
+ * New pages are merged into the free block at the end of the heap if there is one.
+ *
+ * @param trueSize - size of the block that needs to fit, including structs
+ * @return boolean - false if the heap's virtual range is exhausted
+ */
+boolean _growHeap(int trueSize){
+	cmcb *tail = _getFreeTail();
+	int needed = trueSize;
+	if (tail != NULL){
+		needed -= tail->size;
+	}
+	int growBy = (needed + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1); //whole pages
+	if (growBy < HEAP_GROW_STEP){
+		growBy = HEAP_GROW_STEP;
+	}
+	if (memSize + growBy > HEAP_VIRT_SIZE){ //clamp to what is left of the range
+		growBy = HEAP_VIRT_SIZE - memSize;
+		if (growBy < needed){
+			return false;
 		}
 	}
+	//the new pages get frames from the page fault handler when first touched, which it only
+	//allows below the break, so move the break before writing any structs there
+	void *oldBreak = heapBreak;
+	heapBreak += growBy;
+	memSize += growBy;
+	if (tail != NULL){ //extend the free tail over the new pages
+		_removeFree(tail);
+		_insertFree(_placeStructs(tail->size + growBy, (void*)tail, FREE, NULL, NULL));
+	}
+	else { //new free block at the old break
+		_insertFree(_placeStructs(growBy, oldBreak, FREE, NULL, NULL));
+	}
+	return true;
+}
+
+/**
+ * Private helper function to release the unused pages at the end of the heap. Only whole pages
+ * past the start of the free tail are released, and only once at least HEAP_GROW_STEP bytes
+ * can go, so alternating allocations and frees at the break do not keep remapping pages.
+ */
+void _shrinkHeap(){
+	cmcb *tail = _getFreeTail();
+	if (tail == NULL){
+		return;
+	}
+	void *keepEnd = (void*)(((u32int)tail + MIN_FREE_BLOCK + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1));
+	if (keepEnd < memHeap + minHeapSize){
+		keepEnd = memHeap + minHeapSize;
+	}
+	if (keepEnd >= heapBreak || heapBreak - keepEnd < HEAP_GROW_STEP){
+		return;
+	}
+
+	boolean zeroed = tail->zeroed;
+	_removeFree(tail);
+	_placeStructs(keepEnd - (void*)tail, (void*)tail, FREE, NULL, NULL);
+	tail->zeroed = zeroed;
+	_insertFree(tail);
+	_unmapHeapPages(keepEnd, heapBreak);
+	memSize -= heapBreak - keepEnd;
+	heapBreak = keepEnd;
+}
+
+/**
+ * Private helper function to find a pre-zeroed free block large enough for a request
+ *
+ * @param trueSize - size of the block needed, including structs
+ * @return cmcb * to the free block, or NULL if none fit
+ */
+cmcb *_findFreeZeroed(int trueSize){
+	cmcb *freeList = freeHead;
+	while (freeList != NULL && (!freeList->zeroed || freeList->size < trueSize)){
+		freeList = freeList->next;
+	}
+	return freeList;
+}
+
+/**
+ * Private helper function to find where an aligned block can start inside a free block. When the
+ * first aligned position leaves a gap too small to stand as a free block of its own, the next
+ * aligned position is used, so the gap always goes back to the free list instead of being padding.
+ *
+ * @param block - the free block
+ * @param align - required alignment of the returned memory, a power of two
+ * @return address the new block's cmcb would start at
+ */
+void *_alignedStart(cmcb *block, int align){
+	u32int user = ((u32int)block + sizeof(struct cmcb) + align - 1) & ~(align - 1);
+	void *start = (void*)(user - sizeof(struct cmcb));
+	if (start != (void*)block && start - (void*)block < MIN_FREE_BLOCK){ //gap too small, use the next spot
+		user = ((u32int)block + MIN_FREE_BLOCK + sizeof(struct cmcb) + align - 1) & ~(align - 1);
+		start = (void*)(user - sizeof(struct cmcb));
+	}
+	return start;
+}
+
+/**
+ * Private helper function to find a free block an aligned block fits in
+ *
+ * @param trueSize - size of the block needed, including structs
+ * @param align - required alignment of the memory, a power of two
+ * @return cmcb * to the free block, or NULL if none fit
+ */
+cmcb *_findFreeAligned(int trueSize, int align){
+	cmcb *freeList = freeHead;
+	while (freeList != NULL && _alignedStart(freeList, align) + trueSize > (void*)freeList + freeList->size){
+		freeList = freeList->next;
+	}
+	return freeList;
+}
+
+/**
+ * Private helper function to find the allocated block that starts at the given pointer. The
+ * cmcb sits right in front of the memory, so it is checked in place instead of searched for.
+ *
+ * @param memPointer - pointer returned by an allocation
+ * @return cmcb * to the block, or NULL if nothing was allocated there
+ */
+cmcb *_findAllocated(void *memPointer){
+	if (memPointer < memHeap + sizeof(struct cmcb) || memPointer >= heapBreak){ //outside the heap
+		return NULL;
+	}
+	cmcb *node = (struct cmcb*)(memPointer - sizeof(struct cmcb));
+	if (node->type != ALLOCATED || node->beginningAddr != memPointer){
+		return NULL;
+	}
+	return node;
+}
+
+/**
+ * Private helper function to get the usage counters new allocations are charged to
+ *
+ * @return memAccount * of the running process, or of the kernel if none is running
+ */
+memAccount *_currentAccount(){
+	pcb *p = getCOP();
+	if (p == NULL){
+		return &kernelAccount;
+	}
+	return &p->mem;
+}
+
+/**
+ * Private helper function to check an allocation against a quota
+ *
+ * @param account - usage counters the bytes would be charged to
+ * @param bytes - how many more bytes the owner would have
+ * @return boolean - false if the allocation would go over the quota
+ */
+boolean _quotaAllows(memAccount *account, int bytes){
+	return account->quota == 0 || account->bytes + bytes <= account->quota;
+}
+
+/**
+ * Private helper function to tag an allocated block with its owner and charge it
+ *
+ * @param block - the allocated block
+ * @param owner - pid of the owner, 0 for the kernel
+ * @param account - usage counters of the owner
+ */
+void _chargeAccount(cmcb *block, int owner, memAccount *account){
+	block->owner = owner;
+	block->account = account;
+	block->ownerPrev = NULL;
+	block->ownerNext = account->blockList;
+	if (account->blockList != NULL){
+		account->blockList->ownerPrev = block;
+	}
+	account->blockList = block;
+	account->bytes += block->size;
+	account->blocks++;
+}
+
+/**
+ * Private helper function to take a block off the usage counters of its owner
+ *
+ * @param block - the allocated block
+ */
+void _releaseAccount(cmcb *block){
+	memAccount *account = block->account;
+	if (block->ownerPrev != NULL){
+		block->ownerPrev->ownerNext = block->ownerNext;
+	}
+	else {
+		account->blockList = block->ownerNext;
+	}
+	if (block->ownerNext != NULL){
+		block->ownerNext->ownerPrev = block->ownerPrev;
+	}
+	account->bytes -= block->size;
+	account->blocks--;
+}
+
+/**
+ * Private helper function to change the size of an allocated block in place, keeping its name,
+ * owner and list links
+ *
+ * @param block - the allocated block
+ * @param trueSize - new size of the block, including structs
+ */
+void _resizeAllocated(cmcb *block, int trueSize){
+	cmcb saved = *block;
+
+	_placeStructs(trueSize, (void*)block, ALLOCATED, saved.prev, saved.next);
+	block->name = saved.name;
+	block->owner = saved.owner;
+	block->account = saved.account;
+	block->ownerNext = saved.ownerNext;
+	block->ownerPrev = saved.ownerPrev;
+	block->guardSize = saved.guardSize;
+
+	memAllocated += trueSize - saved.size;
+	block->account->bytes += trueSize - saved.size;
+	profileResize(block);
+	if (isTracing()){ //replayed as a free and a new allocation of the new size
+		traceFree(block);
+		traceAlloc(block);
+	}
+	if (ktrace_on(KTRACE_HEAP)){
+		ktrace_free((u32int)block);
+		ktrace_alloc((u32int)block, block->memSize);
+	}
+}
+
+/**
+ * Private helper function to carve an allocation out of the front of a free block. The rest of
+ * the free block goes back in the free list, and keeps its pre-zeroed state.
+ *
+ * @param freeBlock - the free block to allocate from
+ * @param trueSize - size of the block needed, including structs
+ * @return cmcb * to the new allocated block
+ */
+cmcb *_allocateFrom(cmcb *freeBlock, int trueSize){
+	//store needed information from freeBlock node
+	void *addr = (void *)freeBlock;
+	int prevSize = freeBlock->size;
+	boolean zeroed = freeBlock->zeroed;
+
+	_removeFree(freeBlock);
+	if (prevSize - trueSize < MIN_FREE_BLOCK){ //remainder too small to be its own block, take all of it
+		trueSize = prevSize;
+	}
+	else {
+		cmcb *newFree = _placeStructs(prevSize - trueSize, addr + trueSize, FREE, NULL, NULL); //make new free
+		newFree->zeroed = zeroed;
+		_insertFree(newFree);
+	}
+
+	cmcb *newAlloc = _placeStructs(trueSize, addr, ALLOCATED, NULL, NULL); //make new allocated
+	newAlloc->name = getCOPName();
+	memAllocated += trueSize;
+	_insertAllocated(newAlloc);
+	pcb *p = getCOP();
+	_chargeAccount(newAlloc, p == NULL ? 0 : p->pid, _currentAccount());
+	if (isProfiling()){
+		profileAlloc(newAlloc, callerFrame);
+	}
+	if (isTracing()){
+		traceAlloc(newAlloc);
+	}
+	if (ktrace_on(KTRACE_HEAP)){
+		ktrace_alloc((u32int)newAlloc, newAlloc->memSize);
+	}
+	return newAlloc;
+}
+
+/**
+ * Private helper function to give the end of an allocated block back to the free list
+ *
+ * @param block - the allocated block to shrink
+ * @param trueSize - new size of the block, including structs
+ */
+void _splitAllocated(cmcb *block, int trueSize){
+	int oldSize = block->size;
+
+	_resizeAllocated(block, trueSize);
+
+	cmcb *newFree = _placeStructs(oldSize - trueSize, (void*)block + trueSize, FREE, NULL, NULL);
+	_mergeAdjacentFree(newFree);
+}
+
+/**
+ * Private helper function to decide whether the page fault handler may map a page of the heap's
+ * virtual range: only pages below the break. Anything past it, including pages the heap has
+ * given back, is a wild access and still panics.
+ *
+ * @param addr - the faulting address
+ * @return int - true if the page may be mapped
+ */
+int _heapAllows(u32int addr){
+	return addr < (u32int)heapBreak;
 }
 
 /**
@@ -95,14 +586,27 @@ boolean initializeHeap(int size){
 		return false;
 	}
 	if (!isInitialized){ //dont try to reinit
+		int initialSize = (_blockSize(size) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1); //whole pages
+		if (initialSize > HEAP_VIRT_SIZE){
+			return false;
+		}
+
+		//the range below the break is demand-zero; frames are mapped in as pages are touched
+		memHeap = HEAP_START;
+		heapBreak = memHeap;
+		if (!register_region((u32int)memHeap, (u32int)memHeap + HEAP_VIRT_SIZE, _heapAllows)){
+			return false;
+		}
 		isInitialized = true;
 		memAllocated = 0;
-		memSize = size;
+		setHeapGuard(HEAP_GUARD_RATE);
+		memSize = initialSize;
+		minHeapSize = initialSize;
+		heapBreak = memHeap + initialSize;
 
-		//allocate memHeap
-		memHeap = (void*)kmalloc(sizeof(struct cmcb) + sizeof(struct lmcb) + size);
 		//create bounding structs for all of free memory
-		freeHead = _placeStructs(size + sizeof(struct cmcb) + sizeof(struct lmcb), memHeap, FREE, NULL, NULL);
+		freeHead = NULL;
+		_insertFree(_placeStructs(initialSize, memHeap, FREE, NULL, NULL));
 		//initialize allocated head
 		allocatedHead = NULL;
 
@@ -112,154 +616,742 @@ boolean initializeHeap(int size){
 }
 
 /**
- * Allocates a memory block if enough memory is availabel
+ * Private helper function to record how long a call took
+ *
+ * @param log - the log to add to
+ * @param start - time stamp taken when the call began
+ */
+void _recordLatency(latencyLog *log, u32int start){
+	log->samples[log->next] = (rdtsc() - start) & 0xFFFFFFFF;
+	log->next = (log->next + 1) % HEAP_LATENCY_SAMPLES;
+	if (log->count < HEAP_LATENCY_SAMPLES){
+		log->count++;
+	}
+}
+
+/**
+ * Private helper function to find the histogram bucket for a block size
+ *
+ * @param size - size of the block in bytes
+ * @return bucket index, 0 to HEAP_HIST_BUCKETS - 1
+ */
+int _sizeBucket(int size){
+	int bucket = 0;
+	size >>= 6; //bucket 0 holds everything under 64 bytes
+	while (size > 0 && bucket < HEAP_HIST_BUCKETS - 1){
+		size >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+/**
+ * Private helper function to record a corrupted block
+ *
+ * @param kind - GUARD_* kind of corruption
+ * @param block - the block it was found in
+ */
+void _guardError(int kind, cmcb *block){
+	static const char *messages[] = {"", "Heap guard: corrupted block header", "Heap guard: canary overwritten",
+			"Heap guard: freed memory written", "Heap guard: block freed twice"};
+
+	guard.errors++;
+	guard.lastKind = kind;
+	guard.lastBlock = block;
+	guard.lastName = kind == GUARD_BAD_HEADER ? "unknown" : block->name;
+	klog(KLOG_MEM, KLOG_ERR, messages[kind]);
+}
+
+/**
+ * Private helper function to check that a block's structs are intact
+ *
+ * @param block - the block
+ * @return boolean - false if the header is corrupted
+ */
+boolean _checkHeader(cmcb *block){
+	if (block->size < (int)(sizeof(struct cmcb) + sizeof(struct lmcb)) || (void*)block + block->size > heapBreak){
+		return false;
+	}
+	if (block->beginningAddr != (void*)block + sizeof(struct cmcb)){
+		return false;
+	}
+	if (block->type != FREE && block->type != ALLOCATED && block->type != QUARANTINED){
+		return false;
+	}
+	lmcb *end = (struct lmcb*)((void*)block + block->size - sizeof(struct lmcb));
+	return end->size == block->size && end->type == block->type;
+}
+
+/**
+ * Private helper function to decide whether the next allocation is guarded
+ *
+ * @return boolean - true if it should get a canary
+ */
+boolean _guardNext(){
+	if (guard.rate == 0){
+		return false;
+	}
+	if (--guardCountdown > 0){
+		return false;
+	}
+	guardCountdown = guard.rate;
+	return true;
+}
+
+/**
+ * Private helper function to write the canary after the requested bytes of a guarded block.
+ * The canary is written a byte at a time since the requested size need not be aligned.
+ *
+ * @param block - the allocated block
+ * @param size - bytes requested
+ */
+void _setCanary(cmcb *block, int size){
+	unsigned char *canary = (unsigned char*)block->beginningAddr + size;
+	int i;
+	for (i = 0; i < GUARD_BYTES; i++){
+		canary[i] = (unsigned char)(0xC5 ^ i);
+	}
+	block->guardSize = size;
+}
+
+/**
+ * Private helper function to check the canary of a guarded block
+ *
+ * @param block - the allocated block
+ * @return boolean - false if the canary was overwritten
+ */
+boolean _checkCanary(cmcb *block){
+	if (block->guardSize == 0){
+		return true;
+	}
+	unsigned char *canary = (unsigned char*)block->beginningAddr + block->guardSize;
+	int i;
+	for (i = 0; i < GUARD_BYTES; i++){
+		if (canary[i] != (unsigned char)(0xC5 ^ i)){
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Private helper function to fill a block's memory with poison
+ *
+ * @param block - the block
+ */
+void _poison(cmcb *block){
+	unsigned char *mem = (unsigned char*)block->beginningAddr;
+	int i;
+	for (i = 0; i < block->memSize; i++){
+		mem[i] = GUARD_POISON;
+	}
+}
+
+/**
+ * Private helper function to check that a quarantined block still holds its poison
+ *
+ * @param block - the quarantined block
+ * @return boolean - false if the memory was written after it was freed
+ */
+boolean _checkPoison(cmcb *block){
+	unsigned char *mem = (unsigned char*)block->beginningAddr;
+	int i;
+	for (i = 0; i < block->memSize; i++){
+		if (mem[i] != GUARD_POISON){
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Private helper function to give a quarantined block back to the free list
+ *
+ * @param block - the quarantined block
+ */
+void _releaseQuarantined(cmcb *block){
+	if (!_checkPoison(block)){
+		_guardError(GUARD_BAD_POISON, block);
+	}
+	_mergeAdjacentFree(_placeStructs(block->size, (void*)block, FREE, NULL, NULL));
+	_shrinkHeap();
+}
+
+/**
+ * Private helper function to poison a freed guarded block and hold it back from reuse. The
+ * oldest quarantined block is released once the quarantine is full.
+ *
+ * @param block - the block being freed, already off the allocated list
+ */
+void _quarantineBlock(cmcb *block){
+	block->type = QUARANTINED;
+	((lmcb*)((void*)block + block->size - sizeof(struct lmcb)))->type = QUARANTINED;
+	_poison(block);
+
+	int slot = (quarantineHead + guard.quarantined) % HEAP_QUARANTINE;
+	if (guard.quarantined == HEAP_QUARANTINE){ //full, the oldest goes back to the free list
+		_releaseQuarantined(quarantine[quarantineHead]);
+		quarantineHead = (quarantineHead + 1) % HEAP_QUARANTINE;
+		guard.quarantined--;
+	}
+	quarantine[slot] = block;
+	guard.quarantined++;
+}
+
+/**
+ * Private helper function to remember the frame of the outermost public heap function, so
+ * blocks are profiled against the code that called into the heap and not the heap itself
+ *
+ * @param frame - frame address of the public function
+ * @return boolean - true if this is the outermost call, and must be passed to _leaveHeap
+ */
+boolean _enterHeap(void **frame){
+	if (callerFrame != NULL){
+		return false;
+	}
+	callerFrame = frame;
+	return true;
+}
+
+/**
+ * Private helper function to undo _enterHeap when a public heap function returns
+ *
+ * @param outer - value returned by _enterHeap
+ */
+void _leaveHeap(boolean outer){
+	if (outer){
+		callerFrame = NULL;
+	}
+}
+
+/**
+ * Private helper function that does the work of allocateMemory
+ *
+ * @param size - size of memory to allocate in bytes
+ * @return pointer to the memory, or NULL if it could not be allocated
+ */
+void *_allocateMemory(int size){
+	if (!isInitialized){ //not init
+		return NULL;
+	}
+	if (size <= 0){ //invalid params
+		return NULL;
+	}
+
+	boolean guarded = _guardNext();
+	int trueSize = _blockSize(guarded ? size + GUARD_BYTES : size); //true size that new node will need, size + struct sizes
+	if (!_quotaAllows(_currentAccount(), trueSize)){ //process is at its limit
+		return NULL;
+	}
+	cmcb *freeBlock = findFreeFit(trueSize);
+	if (freeBlock == NULL){ //no large enough contiguous chunk of memory, map more
+		if (!_growHeap(trueSize)){
+			return NULL;
+		}
+		freeBlock = findFreeFit(trueSize);
+		if (freeBlock == NULL){
+			return NULL;
+		}
+	}
+
+	cmcb *block = _allocateFrom(freeBlock, trueSize);
+	if (guarded){
+		_setCanary(block, size);
+		guard.guarded++;
+	}
+	return block->beginningAddr;
+}
+
+/**
+ * Allocates a memory block if enough memory is availabel, growing the heap if no free block fits
  *
  * @param size - size of memory to allocate in bytes
  * @return pointer to the me
  */
 void *allocateMemory(int size){
+	boolean outer = _enterHeap(__builtin_frame_address(0));
+	u32int start = rdtsc();
+	void *mem = _allocateMemory(size);
+	_recordLatency(&allocLatency, start);
+	_leaveHeap(outer);
+	return mem;
+}
+
+/**
+ * Private helper function that does the work of allocateAligned
+ *
+ * @param size - size of memory to allocate in bytes
+ * @param align - required alignment in bytes, a power of two
+ * @return pointer to the aligned memory, or NULL if it could not be allocated
+ */
+void *_allocateAligned(int size, int align){
 	if (!isInitialized){ //not init
 		return NULL;
 	}
-	if (size == 0){ //invalid params
+	if (size <= 0 || align <= 0 || (align & (align - 1)) != 0){ //invalid params
 		return NULL;
 	}
-	if (memSize - memAllocated < (int)(sizeof(struct cmcb) + sizeof(struct lmcb) + size)){ //not enough mem
-		return NULL;
+	if (align <= 4){ //every block is already 4-byte aligned
+		return allocateMemory(size);
 	}
 
-	int trueSize = sizeof(struct cmcb) + sizeof(struct lmcb) + size; //true size that new node will need, size + struct sizes
-	boolean memPosNotFound = true;
-	cmcb *freeList = freeHead;
-	while (memPosNotFound){
-		if (freeList == NULL){ //end of memory, not a large enough contiguous chunk of memory
+	int trueSize = _blockSize(size);
+	if (!_quotaAllows(_currentAccount(), trueSize)){ //process is at its limit
+		return NULL;
+	}
+	cmcb *freeBlock = _findFreeAligned(trueSize, align);
+	if (freeBlock == NULL){ //map enough for the worst case gap in front of the block
+		if (!_growHeap(trueSize + align + MIN_FREE_BLOCK)){
 			return NULL;
 		}
-		if (freeList->memSize >= trueSize){ //found spot
-			memPosNotFound = false;
-		}
-		else { //go to next node
-			freeList = freeList->next;
+		freeBlock = _findFreeAligned(trueSize, align);
+		if (freeBlock == NULL){
+			return NULL;
 		}
 	}
-	//store needed information from freeList node
-	cmcb *prev = freeList->prev;
-	cmcb *next = freeList->next;
-	void *addr = (void *)freeList;
-	int prevSize = freeList->size;
 
-	cmcb *newAlloc = _placeStructs(trueSize, addr, ALLOCATED, NULL, NULL); //make new allocated
-	newAlloc->name = getCOPName();
-	memAllocated += trueSize;
-	cmcb *newFree = _placeStructs(prevSize - trueSize, (void*)newAlloc + newAlloc->size, FREE, prev, next); //make new free
-	if (prev != NULL){
-		prev->next = newFree;
+	void *start = _alignedStart(freeBlock, align);
+	if (start != (void*)freeBlock){ //split the gap in front off as its own free block
+		int gap = start - (void*)freeBlock;
+		int rest = freeBlock->size - gap;
+		boolean zeroed = freeBlock->zeroed;
+
+		_removeFree(freeBlock);
+		cmcb *front = _placeStructs(gap, (void*)freeBlock, FREE, NULL, NULL);
+		cmcb *back = _placeStructs(rest, start, FREE, NULL, NULL);
+		front->zeroed = zeroed;
+		back->zeroed = zeroed;
+		_insertFree(front);
+		_insertFree(back);
+		freeBlock = back;
+	}
+	return _allocateFrom(freeBlock, trueSize)->beginningAddr;
+}
+
+/**
+ * Allocates a memory block whose address is a multiple of the given alignment. The space in
+ * front of the aligned address stays in the free list, and the block is freed like any other
+ * with deallocateMemory.
+ *
+ * @param size - size of memory to allocate in bytes
+ * @param align - required alignment in bytes, a power of two
+ * @return pointer to the aligned memory, or NULL if it could not be allocated
+ */
+void *allocateAligned(int size, int align){
+	boolean outer = _enterHeap(__builtin_frame_address(0));
+	void *mem = _allocateAligned(size, align);
+	_leaveHeap(outer);
+	return mem;
+}
+
+/**
+ * Private helper function that does the work of callocMemory
+ *
+ * @param count - number of elements
+ * @param size - size of each element in bytes
+ * @return pointer to the zeroed memory, or NULL if it could not be allocated
+ */
+void *_callocMemory(int count, int size){
+	if (!isInitialized){ //not init
+		return NULL;
 	}
-	if (next != NULL){
-		next->prev = newFree;
+	if (count <= 0 || size <= 0 || count > 0x7FFFFFFF / size){ //invalid params or overflow
+		return NULL;
+	}
+
+	int trueSize = _blockSize(count * size);
+	if (!_quotaAllows(_currentAccount(), trueSize)){ //process is at its limit
+		return NULL;
 	}
-	if(newFree->prev == NULL){
-		freeHead = newFree;
+	cmcb *freeBlock = _findFreeZeroed(trueSize);
+	if (freeBlock != NULL){ //pre-zeroed, nothing to clear
+		return _allocateFrom(freeBlock, trueSize)->beginningAddr;
 	}
 
-	boolean spotFound = false;
-	if (allocatedHead == NULL) {
-		allocatedHead = newAlloc;
-		return newAlloc->beginningAddr;
+	void *mem = allocateMemory(count * size);
+	if (mem != NULL){
+		_zeroWords(mem, count * size);
 	}
-	cmcb *node = allocatedHead;
-	while(!spotFound){
-		if (newAlloc < node){
-			newAlloc->next = node;
-			newAlloc->prev = node->prev;
-			newAlloc->prev->next = newAlloc;
-			node->prev = newAlloc;
-			if (allocatedHead == node) {
-				allocatedHead = newAlloc;
-			}
-			spotFound = true;
+	return mem;
+}
+
+/**
+ * Allocates zeroed memory for an array. Pre-zeroed free blocks are used when one fits, so the
+ * memory only has to be cleared when none do.
+ *
+ * @param count - number of elements
+ * @param size - size of each element in bytes
+ * @return pointer to the zeroed memory, or NULL if it could not be allocated
+ */
+void *callocMemory(int count, int size){
+	boolean outer = _enterHeap(__builtin_frame_address(0));
+	void *mem = _callocMemory(count, size);
+	_leaveHeap(outer);
+	return mem;
+}
+
+/**
+ * Private helper function that does the work of reallocateMemory
+ *
+ * @param memPointer - pointer to the mem block, or NULL to allocate a new one
+ * @param size - new size in bytes, or 0 to free the block
+ * @return pointer to the resized block, or NULL if it could not be resized
+ */
+void *_reallocateMemory(void *memPointer, int size){
+	if (memPointer == NULL){
+		return allocateMemory(size);
+	}
+	if (size <= 0){
+		deallocateMemory(memPointer);
+		return NULL;
+	}
+
+	cmcb *block = _findAllocated(memPointer);
+	if (block == NULL){ //not an allocated block
+		return NULL;
+	}
+	if (!_checkCanary(block)){
+		_guardError(GUARD_BAD_CANARY, block);
+	}
+
+	boolean guarded = block->guardSize != 0;
+	int trueSize = _blockSize(guarded ? size + GUARD_BYTES : size);
+	if (trueSize <= block->size){ //shrink in place
+		if (block->size - trueSize >= MIN_FREE_BLOCK){
+			_splitAllocated(block, trueSize);
+			_shrinkHeap();
+		}
+		if (guarded){
+			_setCanary(block, size);
+		}
+		return memPointer;
+	}
+
+	void *end = (void*)block + block->size;
+	if (end == heapBreak){ //last block, map enough for it to grow in place
+		_growHeap(trueSize - block->size);
+	}
+	cmcb *next = (struct cmcb*)end;
+	if (end < heapBreak && next->type == FREE && block->size + next->size >= trueSize
+			&& _quotaAllows(block->account, trueSize - block->size)){ //grow in place
+		//store needed information from next before its structs are overwritten
+		int combined = block->size + next->size;
+		boolean zeroed = next->zeroed;
+
+		_removeFree(next);
+		if (combined - trueSize < MIN_FREE_BLOCK){ //take all of next
+			trueSize = combined;
 		}
-		else if (node->next == NULL){
-			node->next = newAlloc;
-			newAlloc->prev = node;
-			spotFound = true;
+		else { //the rest of next stays free
+			cmcb *newFree = _placeStructs(combined - trueSize, (void*)block + trueSize, FREE, NULL, NULL);
+			newFree->zeroed = zeroed;
+			_insertFree(newFree);
 		}
-		else {
-			node = node->next;
+
+		_resizeAllocated(block, trueSize);
+		if (guarded){
+			_setCanary(block, size);
+		}
+		return memPointer;
+	}
+
+	//no room here, move it
+	if (!_quotaAllows(block->account, trueSize - block->size)){
+		return NULL;
+	}
+	void *newMem = allocateMemory(size);
+	if (newMem == NULL){
+		return NULL;
+	}
+	cmcb *moved = _findAllocated(newMem); //stays with the owner of the old block
+	_releaseAccount(moved);
+	_chargeAccount(moved, block->owner, block->account);
+	int keep = guarded ? block->guardSize : block->memSize; //the old canary must not land on the new one
+	_copyWords(newMem, memPointer, keep < size ? keep : size);
+	deallocateMemory(memPointer);
+	return newMem;
+}
+
+/**
+ * Changes the size of an allocated block. The block shrinks in place, and grows in place when
+ * the block physically after it is free and large enough; otherwise it is moved.
+ *
+ * @param memPointer - pointer to the mem block, or NULL to allocate a new one
+ * @param size - new size in bytes, or 0 to free the block
+ * @return pointer to the resized block, or NULL if it could not be resized (the block is untouched)
+ */
+void *reallocateMemory(void *memPointer, int size){
+	boolean outer = _enterHeap(__builtin_frame_address(0));
+	void *mem = _reallocateMemory(memPointer, size);
+	_leaveHeap(outer);
+	return mem;
+}
+
+/**
+ * Zeroes one free block that is not yet known to be zero, refilling the pool callocMemory takes
+ * pre-zeroed blocks from. Called from the idle process.
+ *
+ * @return boolean - true if a block was zeroed
+ */
+boolean scrubFreeMemory(){
+	if (!isInitialized){
+		return false;
+	}
+	cmcb *freeList = freeHead;
+	while (freeList != NULL && freeList->zeroed){
+		freeList = freeList->next;
+	}
+	if (freeList == NULL){ //pool is full
+		return false;
+	}
+	_zeroWords(freeList->beginningAddr, freeList->memSize);
+	freeList->zeroed = true;
+	return true;
+}
+
+/**
+ * Private helper function that does the work of deallocateMemory
+ *
+ * @param memPointer - pointer to the mem block
+ * @return boolean - boolean telling whether succesful dealloc
+ */
+boolean _deallocateMemory(void *memPointer){
+	cmcb *node = _findAllocated(memPointer);
+	if (node == NULL){ //reach end, not found
+		cmcb *header = (struct cmcb*)(memPointer - sizeof(struct cmcb));
+		if (guard.rate != 0 && memPointer > memHeap + sizeof(struct cmcb) && memPointer < heapBreak
+				&& header->type == QUARANTINED && header->beginningAddr == memPointer){
+			_guardError(GUARD_DOUBLE_FREE, header);
 		}
+		return false;
+	}
+	if (!_checkHeader(node)){ //freeing it would spread the damage
+		_guardError(GUARD_BAD_HEADER, node);
+		return false;
+	}
+	if (!_checkCanary(node)){
+		_guardError(GUARD_BAD_CANARY, node);
+	}
+	_unlinkBlock(node, &allocatedHead);
+	_releaseAccount(node);
+	profileFree(node);
+	if (isTracing()){
+		traceFree(node);
 	}
-	return newAlloc->beginningAddr;
+	if (ktrace_on(KTRACE_HEAP)){
+		ktrace_free((u32int)node);
+	}
+	memAllocated -= node->size;
+	if (node->guardSize != 0 && guard.rate != 0){
+		_quarantineBlock(node);
+		return true;
+	}
+
+	cmcb *newFree = _placeStructs(node->size, (void*)node, FREE, NULL, NULL); //make new free block
+	_mergeAdjacentFree(newFree);
+	_shrinkHeap();
+	return true;
 }
 
 /**
- * Deallocates the block of memory at the mempointer
+ * Deallocates the block of memory at the mempointer, releasing trailing pages if the heap shrank
  *
  * @param memPointer - pointer to the mem block
  * @return boolean - boolean telling whether succesful dealloc
  */
 boolean deallocateMemory(void *memPointer){
-	boolean isFound = false;
-	cmcb *node = allocatedHead;
+	u32int start = rdtsc();
+	boolean freed = _deallocateMemory(memPointer);
+	_recordLatency(&freeLatency, start);
+	return freed;
+}
 
-	while (!isFound){
-		if (node == NULL){ //reach end, not found
-			return false;
+/**
+ * Fills in a summary of the free and allocated lists
+ *
+ * @param stats - struct to fill in
+ * @return boolean - false if the heap is not initialized
+ */
+boolean getHeapStats(heapStats *stats){
+	if (!isInitialized){
+		return false;
+	}
+
+	int i;
+	for (i = 0; i < HEAP_HIST_BUCKETS; i++){
+		stats->freeHist[i] = 0;
+		stats->allocatedHist[i] = 0;
+	}
+	stats->heapSize = memSize;
+	stats->totalFree = 0;
+	stats->freeBlocks = 0;
+	stats->largestFree = 0;
+	stats->totalAllocated = memAllocated;
+	stats->allocatedBlocks = 0;
+
+	cmcb *node;
+	for (node = freeHead; node != NULL; node = node->next){
+		stats->totalFree += node->size;
+		stats->freeBlocks++;
+		stats->freeHist[_sizeBucket(node->size)]++;
+		if (node->size > stats->largestFree){
+			stats->largestFree = node->size;
+		}
+	}
+	for (node = allocatedHead; node != NULL; node = node->next){
+		stats->allocatedBlocks++;
+		stats->allocatedHist[_sizeBucket(node->size)]++;
+	}
+
+	if (stats->totalFree == 0){
+		stats->fragmentation = 0;
+	}
+	else { //fits in an int since the heap is at most HEAP_VIRT_SIZE
+		stats->fragmentation = 100 - stats->largestFree * 100 / stats->totalFree;
+	}
+	return true;
+}
+
+/**
+ * Returns the cycle counts of recent allocateMemory calls
+ *
+ * @return latencyLog * of allocate timings
+ */
+latencyLog *getAllocLatency(){
+	return &allocLatency;
+}
+
+/**
+ * Returns the cycle counts of recent deallocateMemory calls
+ *
+ * @return latencyLog * of free timings
+ */
+latencyLog *getFreeLatency(){
+	return &freeLatency;
+}
+
+/**
+ * Discards all recorded allocate and free timings
+ */
+void resetLatency(){
+	allocLatency.count = 0;
+	allocLatency.next = 0;
+	freeLatency.count = 0;
+	freeLatency.next = 0;
+}
+
+/**
+ * Frees every block owned by a process. Called when the process exits. A block whose header
+ * is damaged cannot be freed safely, so it is leaked on purpose and dropped from the process'
+ * list; the rest of the list is only followed if the next block looks intact.
+ *
+ * @param p - the process
+ * @return number of blocks freed
+ */
+int freeProcessMemory(pcb *p){
+	int count = 0;
+	cmcb *block;
+	while ((block = p->mem.blockList) != NULL){
+		if (_checkHeader(block) && deallocateMemory(block->beginningAddr)){
+			count++;
+			continue;
 		}
-		if (node->beginningAddr == memPointer){
-			isFound = true;
+
+		_guardError(GUARD_BAD_HEADER, block);
+		cmcb *next = block->ownerNext; //may be damaged along with the header
+		if (next != NULL && ((void*)next < memHeap || (void*)next >= heapBreak
+				|| !_checkHeader(next) || next->account != &p->mem)){
+			next = NULL; //leak the rest rather than follow a bad link
 		}
-		else{
-			node = node->next;
+		if (next != NULL){
+			next->ownerPrev = NULL;
 		}
+		p->mem.blockList = next;
 	}
-	if (node == allocatedHead){
-		allocatedHead = allocatedHead->next;
+	return count;
+}
 
-		if (allocatedHead != NULL) {
-			allocatedHead->prev = NULL;
-		}
+/**
+ * Returns the usage counters of the allocations made while no process was running
+ *
+ * @return memAccount * for the kernel
+ */
+memAccount *getKernelAccount(){
+	return &kernelAccount;
+}
+
+/**
+ * Sets how many allocations there are per guarded one. Setting it to 0 turns guard mode off and
+ * releases the quarantine.
+ *
+ * @param rate - one in this many allocations is guarded, 0 for none
+ */
+void setHeapGuard(int rate){
+	if (rate < 0){
+		return;
 	}
-	else {
-		if (node->next != NULL){
-			node->next->prev = node->prev;
-		}
-		if (node->prev != NULL){
-			node->prev->next = node->next;
+	guard.rate = rate;
+	guardCountdown = rate;
+	if (rate == 0){
+		while (guard.quarantined > 0){
+			_releaseQuarantined(quarantine[quarantineHead]);
+			quarantineHead = (quarantineHead + 1) % HEAP_QUARANTINE;
+			guard.quarantined--;
 		}
 	}
+}
 
-	cmcb *newFree = _placeStructs(node->size, (void*)node, FREE, NULL, NULL); //make new free block
-	memAllocated -= newFree->size;
-	if (freeHead == NULL){
-		freeHead = newFree;
+/**
+ * Checks heap headers, canaries of guarded blocks and poison of quarantined blocks, picking up
+ * where the last call stopped. The walk starts over if the heap changed in between. Partial
+ * sweeps are for the idle process and only run in guard mode.
+ *
+ * @param maxBlocks - most blocks to check, 0 for the whole heap
+ * @return number of errors found
+ */
+int heapGuardSweep(int maxBlocks){
+	if (!isInitialized || (maxBlocks != 0 && guard.rate == 0)){ //background sweeps only run in guard mode
+		return 0;
 	}
-	else {
-		boolean spotFound = false;
-		cmcb *newNode = freeHead;
-		while (!spotFound){
-			if (newFree < newNode){
-				newFree->prev = newNode->prev;
-				newFree->next = newNode;
-				newNode->prev->next = newFree;
-				newNode->prev = newFree;
-				spotFound = true;
-
-				if (newNode == freeHead){
-					freeHead = newFree;
-				}
-			}
-			else if (newNode->next == NULL){
-				newNode->next = newFree;
-				newFree->prev = newNode;
-				spotFound = true;
-			}
-			else {
-				newNode = newNode->next;
-			}
+	if (maxBlocks == 0 || sweepCursor == NULL || sweepChanges != layoutChanges){ //blocks may have moved
+		sweepCursor = memHeap;
+	}
+
+	int errors = guard.errors;
+	int checked = 0;
+	while (sweepCursor < heapBreak && (maxBlocks == 0 || checked < maxBlocks)){
+		cmcb *block = (struct cmcb*)sweepCursor;
+		if (!_checkHeader(block)){ //cannot trust the size to find the next block
+			_guardError(GUARD_BAD_HEADER, block);
+			sweepCursor = heapBreak;
+			break;
 		}
+		if (block->type == ALLOCATED && !_checkCanary(block)){
+			_guardError(GUARD_BAD_CANARY, block);
+		}
+		else if (block->type == QUARANTINED && !_checkPoison(block)){
+			_guardError(GUARD_BAD_POISON, block);
+			_poison(block); //report it once
+		}
+		sweepCursor += block->size;
+		checked++;
 	}
-	_mergeAdjacentFree();
-	return true;
+
+	if (sweepCursor >= heapBreak){ //full pass done
+		guard.sweeps++;
+		sweepCursor = memHeap;
+	}
+	sweepChanges = layoutChanges;
+	return guard.errors - errors;
+}
+
+/**
+ * Fills in the guard mode counters and the last error found
+ *
+ * @param report - struct to fill in
+ */
+void getGuardReport(guardReport *report){
+	*report = guard;
 }
 
 /**
@@ -290,4 +1382,4 @@ cmcb *getFreeHead() {
  */
 cmcb *getAllocatedHead() {
 	return allocatedHead;
-}
\ No newline at end of file
+}
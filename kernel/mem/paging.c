@@ -7,23 +7,41 @@
 */
 
 #include <system.h>
+#include <string.h>
+#include <core/klog.h>
+#include <core/multiboot.h>
+#include <core/tables.h>
 #include <modules/mpx_supt.h>
 
 #include "mem/heap.h"
 #include "mem/paging.h"
+#include "mem/memoryControl.h"
+#include "mem/stack.h"
 
-u32int mem_size = 0x4000000; //64MB
+u32int mem_size = 0x4000000; //64MB unless the boot loader says otherwise
 u32int page_size = 0x1000; //4KB
 
+mem_region regions[MAX_MEM_REGIONS]; //usable RAM
+int nregions = 0; //number of usable regions
+
 u32int nframes; //number of frames
 u32int *frames; //bitmap of frames
 
+u32int *frame_stack; //recently freed frames, popped before scanning
+u32int frame_stack_top = 0; //number of frames on the stack
+u32int frame_hint = 0; //bitmap word to resume scanning from
+u32int used_frames = 0; //frames handed out by new_frame
+u32int free_frames = 0; //usable frames not in use
+int pse_enabled = 0; //identity region mapped with 4MB pages
+
+fault_region fault_regions[MAX_FAULT_REGIONS]; //demand-zero address ranges
+u32int demand_faults = 0; //pages mapped in by the fault handler
+
 page_dir *kdir = 0; //kernel directory
 page_dir *cdir = 0; //current directory
 
 //defined in heap.c
 extern u32int phys_alloc_addr;
-extern heap *kheap;
 
 /**
  * Marks a page frame bit as in use (1).
@@ -63,23 +81,64 @@ u32int get_bit(u32int addr) {
 }
 
 /**
- * Finds the first free page frame.
+ * Finds a free page frame. Scans the bitmap a word at a time, starting at
+ * the word the last scan stopped at and wrapping around once.
  *
- * @return The first free page frame
+ * @return A free page frame
  */
 u32int first_free() {
-	u32int i, j;
-	for (i = 0; i < nframes / 32; i++)
-		if (frames[i] != 0xFFFFFFFF) //if frame not full
-			for (j = 0; j < 32; j++) //find first free bit
-				if (!(frames[i] & (1 << j)))
-					return i * 32 + j;
+	u32int words = nframes / 32;
+	u32int n, i;
+
+	for (n = 0; n < words; n++) {
+		i = (frame_hint + n) % words;
+		if (frames[i] != 0xFFFFFFFF) { //if frame not full
+			frame_hint = i;
+			return i * 32 + __builtin_ctzl(~frames[i]); //bsf on the first clear bit
+		}
+	}
 
 	return -1; //no free frames
 }
 
+/**
+ * Takes a free page frame, from the free-frame stack if it holds one and
+ * from the bitmap otherwise.
+ *
+ * @return A free page frame
+ */
+u32int alloc_frame() {
+	//the bitmap scan may have handed out a stacked frame since it was pushed
+	while (frame_stack_top > 0) {
+		u32int index = frame_stack[--frame_stack_top];
+		if (!get_bit(index * page_size))
+			return index;
+	}
+
+	return first_free();
+}
+
+/**
+ * Returns the number of usable frames not in use.
+ *
+ * @return The number of free frames
+ */
+u32int get_free_frames() {
+	return free_frames;
+}
+
+/**
+ * Returns the number of frames in use.
+ *
+ * @return The number of used frames
+ */
+u32int get_used_frames() {
+	return used_frames;
+}
+
 /**
  * Finds and returns a page, allocating a new page table if necessary.
+ * Returns 0 for addresses mapped with a 4MB page.
  *
  * @param addr The address of the page
  * @param dir The page directory
@@ -91,6 +150,10 @@ page_entry *get_page(u32int addr, page_dir *dir, int make_table) {
 	u32int index = addr / page_size / 1024;
 	u32int offset = addr / page_size % 1024;
 
+	//4MB pages have no page table to return
+	if (dir->tables_phys[index] & PDE_LARGE)
+		return 0;
+
 	//return it if it exists
 	if (dir->tables[index])
 		return &dir->tables[index]->pages[offset];
@@ -103,34 +166,169 @@ page_entry *get_page(u32int addr, page_dir *dir, int make_table) {
 	} else return 0;
 }
 
+/**
+ * Checks whether the CPU supports 4MB pages.
+ *
+ * @return True if PSE is supported
+ */
+int has_pse() {
+	u32int eax = 1, ebx, ecx, edx;
+	asm volatile ("cpuid"
+	: "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+	return (edx & CPUID_PSE) != 0;
+}
+
+/**
+ * Identity maps a single 4KB page and marks its frame in use.
+ *
+ * @param addr The address of the page
+ */
+void identity_page(u32int addr) {
+	page_entry *page = get_page(addr, kdir, 1);
+
+	//reserved frames are mapped but were never free
+	if (!get_bit(addr)) {
+		set_bit(addr);
+		used_frames++;
+		free_frames--;
+	}
+	page->present = 1;
+	page->writeable = 1;
+	page->frameaddr = addr / page_size;
+}
+
+/**
+ * Identity maps a 4MB region with a single directory entry and marks its
+ * frames in use. PSE must be enabled before paging is.
+ *
+ * @param addr The 4MB-aligned address of the region
+ */
+void map_large_page(u32int addr) {
+	u32int word = addr / page_size / 32;
+	u32int count = LARGE_PAGE_SIZE / page_size;
+	u32int i;
+
+	kdir->tables_phys[addr / LARGE_PAGE_SIZE] = addr | PDE_LARGE | 0x3; //present, writable
+	for (i = 0; i < count / 32 && word + i < nframes / 32; i++) {
+		u32int clear = ~frames[word + i] & 0xFFFFFFFF;
+		for (; clear; clear &= clear - 1) { //count the frames taken
+			used_frames++;
+			free_frames--;
+		}
+		frames[word + i] = 0xFFFFFFFF;
+	}
+}
+
+/**
+ * Adds a region of usable RAM, trimmed to whole frames.
+ *
+ * @param base The start of the region
+ * @param length The length of the region
+ */
+void add_mem_region(u32int base, u32int length) {
+	u32int start = (base + page_size - 1) & ~(page_size - 1);
+	u32int end = (base + length) & ~(page_size - 1);
+
+	if (base + length < base) //runs past 4GB
+		end = 0xFFFFF000;
+	if (end <= start || nregions >= MAX_MEM_REGIONS)
+		return;
+
+	regions[nregions].base = start;
+	regions[nregions].length = end - start;
+	nregions++;
+	if (end > mem_size || nregions == 1)
+		mem_size = end;
+}
+
+/**
+ * Sizes physical memory from the multiboot information. Only regions the
+ * memory map reports as available are used; reserved, ACPI and NVS
+ * regions stay marked in use. Without a memory map the mem_upper field is
+ * used, and without either the default size is kept.
+ *
+ * @param info The multiboot information structure
+ */
+void detect_memory(multiboot_info *info) {
+	if (info->flags & MULTIBOOT_FLAG_MMAP) {
+		u32int addr = info->mmap_addr;
+		while (addr < info->mmap_addr + info->mmap_length) {
+			mmap_entry *entry = (mmap_entry *) addr;
+			//memory above 4GB cannot be addressed without PAE
+			if (entry->type == MMAP_AVAILABLE && entry->base_high == 0)
+				add_mem_region(entry->base_low, entry->length_high ? 0xFFFFFFFF - entry->base_low : entry->length_low);
+			addr += entry->size + sizeof(entry->size);
+		}
+	} else if (info->flags & MULTIBOOT_FLAG_MEM) {
+		add_mem_region(0, info->mem_lower * 1024);
+		add_mem_region(0x100000, info->mem_upper * 1024);
+	}
+}
+
 /**
  * Initializes the kernel page directory and initial kernel heap area. Performs
  * identity mapping of the kernel frames such that the virtual addresses are
- * equivalent to the physical addresses.
+ * equivalent to the physical addresses. The identity region uses 4MB pages
+ * when the CPU supports them.
  */
 void init_paging() {
-	//create frame bitmap
-	nframes = (u32int)(mem_size / page_size);
-	frames = (u32int *) kmalloc(nframes / 32);
-	memset(frames, 0, nframes / 32);
+	u32int i = 0x0;
+	int r;
+
+	//create frame bitmap; one bit per frame, rounded up to whole words
+	nframes = (u32int)((mem_size / page_size + 31) & ~31);
+	frames = (u32int *) kmalloc(nframes / 8);
+
+	//everything outside the usable regions stays marked in use
+	if (nregions == 0)
+		add_mem_region(0, mem_size);
+	memset(frames, 0xFF, nframes / 8);
+	for (r = 0; r < nregions; r++) {
+		for (i = regions[r].base; i < regions[r].base + regions[r].length; i += page_size) {
+			if (get_bit(i)) {
+				clear_bit(i);
+				free_frames++;
+			}
+		}
+	}
+	frame_stack = (u32int *) kmalloc(FRAME_STACK_SIZE * sizeof(u32int));
 
 	//create kernel directory
 	kdir = (page_dir *) _kmalloc(sizeof(page_dir), 1, 0); //page aligned
 	memset(kdir, 0, sizeof(page_dir));
 
-	//get pages for kernel heap
-	u32int i = 0x0;
-	for (i = KHEAP_BASE; i < (KHEAP_BASE + KHEAP_MIN); i += 1) {
+	//create the page tables for the whole kernel heap range; the heap
+	//maps frames into them as it expands
+	for (i = KHEAP_BASE; i < (KHEAP_BASE + KHEAP_SIZE); i += PAGE_SIZE * 1024) {
 		get_page(i, kdir, 1);
 	}
 
-	//perform identity mapping of used memory
-	//note: placement_addr gets incremented in get_page,
-	//so we're mapping the first frames as well
-	i = 0x0;
-	while (i < (phys_alloc_addr + 0x10000)) {
-		new_frame(get_page(i, kdir, 1));
-		i += page_size;
+	//create the page tables for the process stack region; stack pages
+	//are mapped in as they are touched
+	for (i = STACK_REGION_BASE; i < (STACK_REGION_BASE + STACK_REGION_SIZE); i += PAGE_SIZE * 1024) {
+		get_page(i, kdir, 1);
+	}
+
+	//create the page tables for the R5 heap's virtual range up front;
+	//frames are only mapped in as that heap grows
+	for (i = HEAP_VIRT_BASE; i < (HEAP_VIRT_BASE + HEAP_VIRT_SIZE); i += PAGE_SIZE * 1024) {
+		get_page(i, kdir, 1);
+	}
+
+	//perform identity mapping of used memory, leaving room for the
+	//placement allocations still to come
+	if (has_pse()) {
+		u32int ident_end = (phys_alloc_addr + 0x10000 + LARGE_PAGE_SIZE - 1) & ~(LARGE_PAGE_SIZE - 1);
+		for (i = 0; i < ident_end; i += LARGE_PAGE_SIZE) {
+			map_large_page(i);
+		}
+		pse_enabled = 1;
+	} else {
+		//note: placement_addr gets incremented in get_page,
+		//so we're mapping the new tables as well
+		for (i = 0; i < (phys_alloc_addr + 0x10000); i += page_size) {
+			identity_page(i);
+		}
 	}
 
 	//allocate heap frames now that the placement addr has increased.
@@ -139,11 +337,20 @@ void init_paging() {
 		new_frame(get_page(i, kdir, 1));
 	}
 
+	//4MB pages need PSE turned on before paging is
+	if (pse_enabled) {
+		u32int cr4;
+		asm volatile ("mov %%cr4,%0": "=r"(cr4));
+		cr4 |= CR4_PSE;
+		asm volatile ("mov %0,%%cr4"::"r"(cr4));
+		klog(KLOG_MEM, KLOG_INFO, "Identity mapped with 4MB pages...");
+	}
+
 	//load the kernel page directory; enable paging
 	load_page_dir(kdir);
 
 	//setup the kernel heap
-	kheap = make_heap(KHEAP_BASE, KHEAP_SIZE, KHEAP_BASE + KHEAP_MIN);
+	init_kheap();
 }
 
 /**
@@ -157,6 +364,7 @@ void init_paging() {
  */
 void load_page_dir(page_dir *new_dir) {
 	cdir = new_dir;
+	set_fault_task_cr3((u32int) &cdir->tables_phys[0]);
 	asm volatile ("mov %0,%%cr3"::"b"(&cdir->tables_phys[0]));
 	u32int cr0;
 	asm volatile ("mov %%cr0,%0": "=b"(cr0));
@@ -173,12 +381,133 @@ void load_page_dir(page_dir *new_dir) {
 
 	u32int index;
 	if (page->frameaddr != 0) return;
-	if ((u32int)(-1) == (index = first_free())) kpanic("Out of memory");
+	if ((u32int)(-1) == (index = alloc_frame())) kpanic("Out of memory");
 
 	//mark a frame as in-use
 	set_bit(index * page_size);
+	used_frames++;
+	free_frames--;
 	page->present = 1;
 	page->frameaddr = index;
 	page->writeable = 1;
 	page->usermode = 0;
 }
+
+/**
+ * Releases the frame behind a page in the frame bitmap and marks the page
+ * not present. The frame is pushed on the free-frame stack so the next
+ * new_frame can take it without a scan.
+ *
+ * @param page The page to release the frame of
+ */
+void free_frame(page_entry *page) {
+	if (!page->present) return;
+
+	clear_bit(page->frameaddr * page_size);
+	if (frame_stack_top < FRAME_STACK_SIZE)
+		frame_stack[frame_stack_top++] = page->frameaddr;
+	used_frames--;
+	free_frames++;
+	page->present = 0;
+	page->frameaddr = 0;
+	page->writeable = 0;
+}
+
+/**
+ * Flushes the TLB entry for a single page. Needed after unmapping a page
+ * that may have been accessed.
+ *
+ * @param addr The virtual address of the page
+ */
+void invalidate_page(u32int addr) {
+	asm volatile ("invlpg (%0)"::"r"(addr) : "memory");
+}
+
+/**
+ * Registers a demand-zero region. A not-present fault inside it gets a
+ * zeroed frame instead of a panic. The page tables covering the region
+ * must already exist.
+ *
+ * @param start The first address of the region, page aligned
+ * @param end The address after the region, page aligned
+ * @param allows Decides which addresses in the region may be mapped, or 0 for all
+ * @return 1 on success, 0 if the registry is full
+ */
+int register_region(u32int start, u32int end, int (*allows)(u32int addr)) {
+	int i;
+	for (i = 0; i < MAX_FAULT_REGIONS; i++) {
+		if (fault_regions[i].end == 0) {
+			fault_regions[i].start = start;
+			fault_regions[i].end = end;
+			fault_regions[i].allows = allows;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Removes a demand-zero region. Pages already mapped in stay mapped.
+ *
+ * @param start The first address of the region
+ */
+void unregister_region(u32int start) {
+	int i;
+	for (i = 0; i < MAX_FAULT_REGIONS; i++) {
+		if (fault_regions[i].end != 0 && fault_regions[i].start == start) {
+			fault_regions[i].start = 0;
+			fault_regions[i].end = 0;
+		}
+	}
+}
+
+/**
+ * Finds the demand-zero region containing an address.
+ *
+ * @param addr The address
+ * @return The region, or 0 if the address is in none
+ */
+fault_region *find_region(u32int addr) {
+	int i;
+	for (i = 0; i < MAX_FAULT_REGIONS; i++) {
+		if (addr >= fault_regions[i].start && addr < fault_regions[i].end)
+			return &fault_regions[i];
+	}
+	return 0;
+}
+
+/**
+ * Resolves a page fault by mapping a zeroed frame, if the faulting
+ * address is not present and lies in a demand-zero region.
+ *
+ * @param addr The faulting address, from CR2
+ * @param error The error code pushed by the CPU
+ * @return 1 if the fault was resolved, 0 if it is a real fault
+ */
+int handle_page_fault(u32int addr, u32int error) {
+	u32int page_addr = addr & ~(page_size - 1);
+	fault_region *region = find_region(addr);
+	page_entry *page;
+
+	if ((error & PF_PRESENT) || !region)
+		return 0;
+	if (region->allows && !region->allows(addr))
+		return 0;
+	if (!(page = get_page(page_addr, cdir, 0)) || page->present)
+		return 0;
+
+	new_frame(page);
+	invalidate_page(page_addr);
+	memset((void *) page_addr, 0, page_size);
+	demand_faults++;
+	return 1;
+}
+
+/**
+ * Returns the number of pages mapped in on demand.
+ *
+ * @return The number of demand faults
+ */
+u32int get_demand_faults() {
+	return demand_faults;
+}
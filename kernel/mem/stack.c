@@ -0,0 +1,173 @@
+/*
+  ----- stack.c -----
+
+  Description..: Process stacks. Each stack lives in its own
+	slot of a dedicated virtual region, grows on demand through
+	the page fault handler, and sits above an unmapped guard.
+*/
+
+#include <system.h>
+
+#include "mem/paging.h"
+#include "mem/stack.h"
+
+extern page_dir *kdir; //kernel page directory
+
+u32int stack_limits[MAX_STACKS]; //limit of each slot, 0 if free
+
+/**
+ * Finds the slot holding an address.
+ *
+ * @param addr The address
+ * @return The slot index, or -1 if the address is outside the region
+ */
+int stack_slot(u32int addr) {
+	if (addr < STACK_REGION_BASE || addr >= STACK_REGION_BASE + STACK_REGION_SIZE)
+		return -1;
+	return (addr - STACK_REGION_BASE) / STACK_SLOT_SIZE;
+}
+
+/**
+ * Returns the address just above a slot's stack.
+ *
+ * @param slot The slot index
+ * @return The top of the slot
+ */
+u32int stack_top(int slot) {
+	return STACK_REGION_BASE + (slot + 1) * STACK_SLOT_SIZE;
+}
+
+/**
+ * Decides whether the fault handler may map a page of the stack region:
+ * only pages of a slot in use, within its limit.
+ *
+ * @param addr The faulting address
+ * @return True if the page may be mapped
+ */
+int stack_allows(u32int addr) {
+	int slot = stack_slot(addr);
+	return slot >= 0 && stack_limits[slot] != 0 && addr >= stack_top(slot) - stack_limits[slot];
+}
+
+/**
+ * Registers the stack region with the page fault handler.
+ *
+ * @return 1 on success, 0 if the region could not be registered
+ */
+int init_stacks() {
+	return register_region(STACK_REGION_BASE, STACK_REGION_BASE + STACK_REGION_SIZE, stack_allows);
+}
+
+/**
+ * Rounds a stack limit up to whole pages.
+ *
+ * @param limit The limit in bytes
+ * @return The rounded limit, or 0 if it is out of range
+ */
+u32int stack_round(u32int limit) {
+	limit = (limit + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+	if (limit == 0 || limit > STACK_MAX_LIMIT)
+		return 0;
+	return limit;
+}
+
+/**
+ * Reserves a stack slot. No frames are mapped until the stack is used.
+ *
+ * @param limit The most bytes the stack may grow to
+ * @return The address just above the stack, or 0 if no slot is free
+ */
+u32int alloc_stack(u32int limit) {
+	int slot;
+
+	if (!(limit = stack_round(limit)))
+		return 0;
+	for (slot = 0; slot < MAX_STACKS; slot++) {
+		if (stack_limits[slot] == 0) {
+			stack_limits[slot] = limit;
+			return stack_top(slot);
+		}
+	}
+	return 0;
+}
+
+/**
+ * Releases a stack slot and the frames mapped into it.
+ *
+ * @param addr Any address inside the stack
+ */
+void free_stack(u32int addr) {
+	int slot = stack_slot(addr);
+	u32int page;
+
+	if (slot < 0 || stack_limits[slot] == 0)
+		return;
+	for (page = stack_top(slot) - STACK_SLOT_SIZE; page < stack_top(slot); page += PAGE_SIZE) {
+		page_entry *entry = get_page(page, kdir, 0);
+		if (entry && entry->present) {
+			free_frame(entry);
+			invalidate_page(page);
+		}
+	}
+	stack_limits[slot] = 0;
+}
+
+/**
+ * Changes how far a stack may grow. Lowering the limit does not release
+ * pages the stack has already touched.
+ *
+ * @param addr Any address inside the stack
+ * @param limit The most bytes the stack may grow to
+ * @return The lowest address the stack may now use, or 0 if the limit is invalid
+ */
+u32int set_stack_limit(u32int addr, u32int limit) {
+	int slot = stack_slot(addr);
+
+	if (slot < 0 || stack_limits[slot] == 0 || !(limit = stack_round(limit)))
+		return 0;
+	stack_limits[slot] = limit;
+	return stack_top(slot) - limit;
+}
+
+/**
+ * Returns how far a stack may grow.
+ *
+ * @param addr Any address inside the stack
+ * @return The stack limit in bytes, or 0 if the slot is not in use
+ */
+u32int get_stack_limit(u32int addr) {
+	int slot = stack_slot(addr);
+	return slot < 0 ? 0 : stack_limits[slot];
+}
+
+/**
+ * Returns how much of a stack has frames mapped.
+ *
+ * @param addr Any address inside the stack
+ * @return The committed bytes
+ */
+u32int get_stack_committed(u32int addr) {
+	int slot = stack_slot(addr);
+	u32int page, committed = 0;
+
+	if (slot < 0)
+		return 0;
+	for (page = stack_top(slot) - STACK_SLOT_SIZE; page < stack_top(slot); page += PAGE_SIZE) {
+		page_entry *entry = get_page(page, kdir, 0);
+		if (entry && entry->present)
+			committed += PAGE_SIZE;
+	}
+	return committed;
+}
+
+/**
+ * Checks whether a faulting address lies below the limit of a stack in
+ * use, in its guard area.
+ *
+ * @param addr The faulting address
+ * @return True if the address is a stack overflow
+ */
+int stack_overflowed(u32int addr) {
+	int slot = stack_slot(addr);
+	return slot >= 0 && stack_limits[slot] != 0 && !stack_allows(addr);
+}
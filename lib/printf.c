@@ -0,0 +1,253 @@
+#include <stdarg.h>
+#include <system.h>
+#include <printf.h>
+
+#include <core/serial.h>
+
+/**
+ * Where formatted characters go: a caller's buffer, or a chunk on the
+ * stack that is passed to the serial driver each time it fills.
+ */
+typedef struct {
+	char *buf;
+	int size;
+	int len;     //characters in buf
+	int total;   //characters formatted so far
+	int console; //flush buf to the serial device instead of cutting
+} fmt_out;
+
+/**
+ * Hands a console chunk to the serial driver.
+ *
+ * @param out The output
+ */
+void _fmtFlush(fmt_out *out) {
+	if (out->len > 0) {
+		serial_write(out->buf, out->len);
+		out->len = 0;
+	}
+}
+
+/**
+ * Adds one character to the output.
+ *
+ * @param out The output
+ * @param c The character
+ */
+void _fmtPut(fmt_out *out, char c) {
+	if (out->console) {
+		if (c == '\n') {
+			_fmtPut(out, '\r');
+		}
+		if (out->len == out->size) {
+			_fmtFlush(out);
+		}
+		out->buf[out->len++] = c;
+	} else if (out->len < out->size - 1) {
+		out->buf[out->len++] = c;
+	}
+	out->total++;
+}
+
+/**
+ * Adds a string to the output, padded to a field width.
+ *
+ * @param out The output
+ * @param s The string
+ * @param len The length of the string
+ * @param width The field width
+ * @param left True to pad on the right
+ * @param pad The padding character
+ */
+void _fmtField(fmt_out *out, const char *s, int len, int width, int left, char pad) {
+	int i;
+
+	//a minus sign goes before zero padding, not after it
+	if (pad == '0' && len > 0 && *s == '-') {
+		_fmtPut(out, *s++);
+		len--;
+		width--;
+	}
+	if (!left) {
+		for (i = len; i < width; i++) {
+			_fmtPut(out, pad);
+		}
+	}
+	for (i = 0; i < len; i++) {
+		_fmtPut(out, s[i]);
+	}
+	if (left) {
+		for (i = len; i < width; i++) {
+			_fmtPut(out, ' ');
+		}
+	}
+}
+
+/**
+ * Converts a number to digits.
+ *
+ * @param value The magnitude
+ * @param base 10 or 16
+ * @param negative True to put a minus sign in front
+ * @param digits Room for at least 12 characters; filled from the end
+ * @return The first character of the number inside digits
+ */
+char *_fmtNumber(u32int value, int base, int negative, char *digits) {
+	char *p = digits + 11;
+
+	*p = '\0';
+	do {
+		u32int d = value % base;
+		*--p = d < 10 ? '0' + d : 'a' + d - 10;
+		value /= base;
+	} while (value != 0);
+	if (negative) {
+		*--p = '-';
+	}
+	return p;
+}
+
+/**
+ * Formats into an output. The conversions shared by kvsnprintf and kprintf.
+ *
+ * @param out The output
+ * @param fmt The format
+ * @param args The values to format
+ */
+void _format(fmt_out *out, const char *fmt, va_list args) {
+	char digits[12];
+	const char *s;
+	int width, left, len;
+	char pad;
+
+	for (; *fmt != '\0'; fmt++) {
+		if (*fmt != '%') {
+			_fmtPut(out, *fmt);
+			continue;
+		}
+
+		fmt++;
+		left = 0;
+		pad = ' ';
+		for (; *fmt == '-' || *fmt == '0'; fmt++) {
+			if (*fmt == '-') {
+				left = 1;
+			} else {
+				pad = '0';
+			}
+		}
+		if (left) {
+			pad = ' ';
+		}
+		for (width = 0; *fmt >= '0' && *fmt <= '9'; fmt++) {
+			width = width * 10 + *fmt - '0';
+		}
+		if (*fmt == 'l') {
+			fmt++;
+		}
+
+		switch (*fmt) {
+			case 'd': {
+				int v = va_arg(args, int);
+				s = _fmtNumber(v < 0 ? -(u32int) v : (u32int) v, 10, v < 0, digits);
+				break;
+			}
+			case 'u':
+				s = _fmtNumber(va_arg(args, unsigned int), 10, 0, digits);
+				break;
+			case 'x':
+				s = _fmtNumber(va_arg(args, unsigned int), 16, 0, digits);
+				break;
+			case 'p':
+				_fmtPut(out, '0');
+				_fmtPut(out, 'x');
+				s = _fmtNumber((u32int) va_arg(args, void *), 16, 0, digits);
+				width = 8;
+				pad = '0';
+				left = 0;
+				break;
+			case 's':
+				s = va_arg(args, const char *);
+				if (s == NULL) {
+					s = "(null)";
+				}
+				break;
+			case 'c':
+				digits[0] = (char) va_arg(args, int);
+				digits[1] = '\0';
+				s = digits;
+				break;
+			case '%':
+				s = "%";
+				break;
+			case '\0':
+				return;
+			default:		// Unknown conversions are written out as they are
+				_fmtPut(out, '%');
+				_fmtPut(out, *fmt);
+				continue;
+		}
+
+		for (len = 0; s[len] != '\0'; len++);
+		_fmtField(out, s, len, width, left, pad);
+	}
+}
+
+/**
+ * Formats a string into a buffer. Supports %d %u %x %s %c %p and %%, each
+ * with an optional - (left align), 0 (pad with zeros) and field width. An
+ * l before the conversion is accepted and ignored.
+ *
+ * @param buf The buffer; always terminated if size is more than 0
+ * @param size The size of the buffer
+ * @param fmt The format
+ * @param args The values to format
+ * @return The length of the whole formatted string, even if it was cut
+ */
+int kvsnprintf(char *buf, int size, const char *fmt, va_list args) {
+	fmt_out out = {buf, size, 0, 0, 0};
+
+	_format(&out, fmt, args);
+	if (size > 0) {
+		buf[out.len] = '\0';
+	}
+	return out.total;
+}
+
+/**
+ * Formats a string into a buffer. See kvsnprintf.
+ *
+ * @param buf The buffer; always terminated if size is more than 0
+ * @param size The size of the buffer
+ * @param fmt The format
+ * @return The length of the whole formatted string, even if it was cut
+ */
+int ksnprintf(char *buf, int size, const char *fmt, ...) {
+	va_list args;
+	int total;
+
+	va_start(args, fmt);
+	total = kvsnprintf(buf, size, fmt, args);
+	va_end(args);
+	return total;
+}
+
+/**
+ * Formats a string to the active serial output device. See kvsnprintf.
+ * Each \n is sent as \r\n. The text is written in chunks of up to
+ * KPRINTF_CHUNK characters rather than a character at a time.
+ *
+ * @param fmt The format
+ * @return The number of characters written
+ */
+int kprintf(const char *fmt, ...) {
+	char chunk[KPRINTF_CHUNK];
+	fmt_out out = {chunk, KPRINTF_CHUNK, 0, 0, 1};
+	va_list args;
+
+	va_start(args, fmt);
+	_format(&out, fmt, args);
+	va_end(args);
+	_fmtFlush(&out);
+	return out.total;
+}
@@ -325,3 +325,46 @@ char *strtok(char *s1, const char *s2) {
 	tok_tmp = NULL;
 	return s1;
 }
+
+/**
+ * Copies memory. The regions may overlap. Copies a word at a time when
+ * both pointers are word aligned.
+ *
+ * @param dst The destination
+ * @param src The source
+ * @param n The number of bytes
+ * @return dst
+ */
+void *memmove(void *dst, const void *src, size_t n) {
+	unsigned char *d = (unsigned char *) dst;
+	const unsigned char *s = (const unsigned char *) src;
+	int aligned = (((u32int) d | (u32int) s) & 3) == 0;
+
+	if (d == s || n == 0)
+		return dst;
+
+	if (d < s) {
+		if (aligned) {
+			for (; n >= 4; n -= 4, d += 4, s += 4)
+				*(u32int *) d = *(const u32int *) s;
+		}
+		while (n--)
+			*d++ = *s++;
+	} else {
+		d += n;
+		s += n;
+		if (aligned) {
+			//the ends are misaligned by the same amount; bytes first
+			for (; n > 0 && ((u32int) d & 3) != 0; n--)
+				*--d = *--s;
+			for (; n >= 4; n -= 4) {
+				d -= 4;
+				s -= 4;
+				*(u32int *) d = *(const u32int *) s;
+			}
+		}
+		while (n--)
+			*--d = *--s;
+	}
+	return dst;
+}
@@ -1,4 +1,5 @@
 #include <boolean.h>
+#include <printf.h>
 
 #include <core/comHandler.h>
 #include <core/help.h>
@@ -208,9 +209,7 @@ const char *showPcbInfo(char **args, int numArgs) {
 		node *queue = getReadyQueue();
 
 		if (queue != NULL) {
-			serial_print("\n");
-			serial_println("Ready Queue");
-			serial_println("=======================");
+			kprintf("\nReady Queue\n=======================\n");
 
 			printQueueInfo(queue);
 		}
@@ -219,9 +218,7 @@ const char *showPcbInfo(char **args, int numArgs) {
 			node *queue = getSuspendedReadyQueue();
 
 			if (queue != NULL) {
-				serial_print("\n");
-				serial_println("Suspended-Ready Queue");
-				serial_println("=======================");
+				kprintf("\nSuspended-Ready Queue\n=======================\n");
 
 				printQueueInfo(queue);
 			}
@@ -232,9 +229,7 @@ const char *showPcbInfo(char **args, int numArgs) {
 		node *queue = getBlockedQueue();
 
 		if (queue != NULL) {
-			serial_print("\n");
-			serial_println("Blocked Queue");
-			serial_println("=======================");
+			kprintf("\nBlocked Queue\n=======================\n");
 
 			printQueueInfo(queue);
 		}
@@ -243,9 +238,7 @@ const char *showPcbInfo(char **args, int numArgs) {
 			node *queue = getSuspendedBlockedQueue();
 
 			if (queue != NULL) {
-				serial_print("\n");
-				serial_println("Suspended-Blocked Queue");
-				serial_println("=======================");
+				kprintf("\nSuspended-Blocked Queue\n=======================\n");
 
 
 				printQueueInfo(queue);
@@ -271,24 +264,10 @@ void printQueueInfo(node *queue) {
 }
 
 void printPcbInfo(pcb *p) {
-	char processClass[2];
-	char priority[2];
-	char isSuspended[2];
-	char state[2];
-
-	itoa(p->processClass, processClass, 10);
-	itoa(p->priority, priority, 10);
-	itoa(p->isSuspended, isSuspended, 10);
-	itoa(p->state, state, 10);
-
-	serial_print("Process name: ");
-	serial_println(p->processName);
-	serial_print("Class: ");
-	serial_println(processClass);
-	serial_print("State: ");
-	serial_println(state);
-	serial_print("Suspended Status: ");
-	serial_println(isSuspended);
-	serial_print("Priority: ");
-	serial_println(priority);
+	kprintf("Process name: %s\n"
+			"Class: %d\n"
+			"State: %d\n"
+			"Suspended Status: %d\n"
+			"Priority: %d\n",
+			p->processName, p->processClass, p->state, p->isSuspended, p->priority);
 }
\ No newline at end of file
@@ -1,21 +1,44 @@
 #include <boolean.h>
+#include <printf.h>
 
 #include <core/comHandler.h>
 #include <core/help.h>
+#include <core/ktrace.h>
 #include <core/queue.h>
+#include <core/serial.h>
 #include <boolean.h>
 
 #include <modules/R5/commands/r5commands.h>
 #include <mem/memoryControl.h>
+#include <mem/heapProfile.h>
+#include <mem/paging.h>
+#include <mem/stack.h>
+
+#define PROFILE_TOP 8			// Number of sites shown in each heapProfile ranking
 
 void printBlockInfo(cmcb *blockList);
 void printCmcbInfo(cmcb *block);
+void printAccountInfo(const char *name, int pid, memAccount *account);
+void printQueueAccounts(node *queue);
+void printStackInfo(pcb *process);
+void printStat(const char *label, int value);
+void printCycles(const char *label, u32int cycles);
+void printHistogram(const char *title, int *hist);
+void printLatency(const char *title, latencyLog *log);
+void printTopSites(const char *title, boolean byBytes);
+void printSiteInfo(allocSite *site);
+void printAddress(const char *label, void *addr);
 
 /**
  * Registers the permanent commands in the command handler
  */
 void registerR5PermCommands() {
 	addFunctionDef("showMemory", HELP_R5_COMMAND_SHOWMEMORY, showMemory);
+	addFunctionDef("showProcessMemory", HELP_R5_COMMAND_SHOWPROCESSMEMORY, showProcessMemory);
+	addFunctionDef("heapStats", HELP_R5_COMMAND_HEAPSTATS, heapStatsCommand);
+	addFunctionDef("heapProfile", HELP_R5_COMMAND_HEAPPROFILE, heapProfile);
+	addFunctionDef("heapTrace", HELP_R5_COMMAND_HEAPTRACE, heapTrace);
+	addFunctionDef("heapGuard", HELP_R5_COMMAND_HEAPGUARD, heapGuard);
 }
 
 /**
@@ -67,9 +90,7 @@ const char *showMemory(char **args, int numArgs) {
 		cmcb *freeBlocks = getFreeHead();
 
 		if (freeBlocks != NULL) {
-			serial_print("\n");
-			serial_println("Free Memory");
-			serial_println("=======================");
+			kprintf("\nFree Memory\n=======================\n");
 
 			printBlockInfo(freeBlocks);
 		}
@@ -80,9 +101,7 @@ const char *showMemory(char **args, int numArgs) {
 		cmcb *allocatedBlocks = getAllocatedHead();
 
 		if (allocatedBlocks != NULL) {
-			serial_print("\n");
-			serial_println("Allocated Memory");
-			serial_println("=======================");
+			kprintf("\nAllocated Memory\n=======================\n");
 
 			printBlockInfo(allocatedBlocks);
 		}
@@ -107,24 +126,397 @@ void printBlockInfo(cmcb *blockList) {
 }
 
 void printCmcbInfo(cmcb *block) {
-	char cmcbType[2];
-	char cmcbAddr[50];
-	char cmcbSize[11];
-	char cmcbMemsize[11];
-
-	itoa(block ->type, cmcbType, 10);
-	itoa((int)block ->beginningAddr, cmcbAddr, 10);
-	itoa(block ->size, cmcbSize, 10);
-	itoa(block ->memSize, cmcbMemsize, 10);
-
-	serial_print("CMCB Type: ");
-	serial_println(cmcbType);
-	serial_print("Begining Memory Address: ");
-	serial_println(cmcbAddr);
-	serial_print("Block Size: ");
-	serial_println(cmcbSize);
-	serial_print("Memory Size: ");
-	serial_println(cmcbMemsize);
-	serial_print("Process Name: ");
-	serial_println(block -> name);
+	kprintf("CMCB Type: %d\n"
+			"Begining Memory Address: %d\n"
+			"Block Size: %d\n"
+			"Memory Size: %d\n"
+			"Process Name: %s\n",
+			block->type, (int)block->beginningAddr, block->size, block->memSize, block->name);
+}
+
+/**
+ * Displays the heap and stack usage of the kernel and of every process, or sets a process's
+ * quota or stack limit.
+ *
+ * Usage: showProcessMemory [--quota name bytes] [--stack name bytes]
+ *
+ * Args:
+ *	[no args] - Displays the usage of every process
+ *	--quota name bytes - Limits the process to the given number of bytes, 0 for no limit
+ *	--stack name bytes - Sets how far the process's stack may grow
+ *
+ * @param args The arguments to pass to the function
+ * @param numArgs The number of arguments
+ * @return A status message indicating success/failure
+ */
+const char *showProcessMemory(char **args, int numArgs) {
+	if (numArgs == 3 && strcmp(args[0], "--stack") == 0) {
+		pcb *p = findPCB(args[1]);
+		if (p == NULL) {
+			return "Process not found";
+		}
+
+		int limit = atoi(args[2]);
+		u32int bottom = limit > 0 ? set_stack_limit((u32int) p->stackBottom, limit) : 0;
+		if (bottom == 0) {
+			return HELP_INVALID_ARGUMENTS;
+		}
+		p->stackBottom = (unsigned char *) bottom;
+		return "Stack limit set";
+	} else if (numArgs == 3 && strcmp(args[0], "--quota") == 0) {
+		pcb *p = findPCB(args[1]);
+		if (p == NULL) {
+			return "Process not found";
+		}
+
+		int quota = atoi(args[2]);
+		if (quota < 0) {
+			return HELP_INVALID_ARGUMENTS;
+		}
+		p->mem.quota = quota;
+		return "Quota set";
+	} else if (numArgs != 0) {
+		return HELP_R5_COMMAND_SHOWPROCESSMEMORY;
+	}
+
+	kprintf("\nProcess Memory\n=======================\n");
+
+	printAccountInfo("kernel", 0, getKernelAccount());
+	serial_print("\n");
+
+	pcb *cop = getCOP();
+	if (cop != NULL) {
+		printAccountInfo(cop->processName, cop->pid, &cop->mem);
+		printStackInfo(cop);
+	}
+
+	printQueueAccounts(getReadyQueue());
+	printQueueAccounts(getBlockedQueue());
+	printQueueAccounts(getSuspendedReadyQueue());
+	printQueueAccounts(getSuspendedBlockedQueue());
+
+	return "";
+}
+
+void printQueueAccounts(node *queue) {
+	while (queue != NULL) {
+		printAccountInfo(queue->data->processName, queue->data->pid, &queue->data->mem);
+		printStackInfo(queue->data);
+		queue = queue->next;
+	}
+}
+
+void printAccountInfo(const char *name, int pid, memAccount *account) {
+	char quotaStr[11];
+
+	ksnprintf(quotaStr, sizeof(quotaStr), "%d", account->quota);
+	kprintf("Process Name: %s\n"
+			"PID: %d\n"
+			"Bytes: %d\n"
+			"Blocks: %d\n"
+			"Quota: %s\n",
+			name, pid, account->bytes, account->blocks, account->quota == 0 ? "none" : quotaStr);
+}
+
+void printStackInfo(pcb *process) {
+	printStat("Stack Limit: ", get_stack_limit((u32int) process->stackBottom));
+	printStat("Stack Committed: ", get_stack_committed((u32int) process->stackBottom));
+	serial_print("\n");
+}
+
+/**
+ * Displays a summary of the heap: free and allocated totals, the largest free block, how
+ * fragmented the free memory is, free and used page frames, block size histograms, and
+ * allocate/free latency percentiles.
+ *
+ * Usage: heapStats [--reset]
+ *
+ * Args:
+ *	[no args] - Displays the summary
+ *	--reset - Discards the recorded latencies
+ *
+ * @param args The arguments to pass to the function
+ * @param numArgs The number of arguments
+ * @return A status message indicating success/failure
+ */
+const char *heapStatsCommand(char **args, int numArgs) {
+	if (numArgs == 1 && strcmp(args[0], "--reset") == 0) {
+		resetLatency();
+		return "Latencies reset";
+	} else if (numArgs != 0) {
+		return HELP_R5_COMMAND_HEAPSTATS;
+	}
+
+	heapStats stats;
+	if (!getHeapStats(&stats)) {
+		return "Heap is not initialized";
+	}
+
+	kprintf("\nHeap Summary\n=======================\n");
+	printStat("Heap Size: ", stats.heapSize);
+	printStat("Allocated Bytes: ", stats.totalAllocated);
+	printStat("Allocated Blocks: ", stats.allocatedBlocks);
+	printStat("Free Bytes: ", stats.totalFree);
+	printStat("Free Blocks: ", stats.freeBlocks);
+	printStat("Largest Free Block: ", stats.largestFree);
+	printStat("Fragmentation (%): ", stats.fragmentation);
+	printStat("Free Frames: ", get_free_frames());
+	printStat("Used Frames: ", get_used_frames());
+
+	printHistogram("Free Block Sizes", stats.freeHist);
+	printHistogram("Allocated Block Sizes", stats.allocatedHist);
+
+	printLatency("Allocate Latency (cycles)", getAllocLatency());
+	printLatency("Free Latency (cycles)", getFreeLatency());
+
+	return "";
+}
+
+void printStat(const char *label, int value) {
+	kprintf("%s%d\n", label, value);
+}
+
+void printCycles(const char *label, u32int cycles) {
+	kprintf("%s%u\n", label, cycles);
+}
+
+void printHistogram(const char *title, int *hist) {
+	kprintf("\n%s\n=======================\n", title);
+
+	int i;
+	for (i = 0; i < HEAP_HIST_BUCKETS; i++) {
+		if (hist[i] == 0) {			// Skip empty buckets to keep the report short
+			continue;
+		}
+
+		if (i == HEAP_HIST_BUCKETS - 1) {
+			kprintf("%d+: %d\n", 1 << (i + 5), hist[i]);
+		} else {
+			kprintf("%d-%d: %d\n", i == 0 ? 0 : 1 << (i + 5), (1 << (i + 6)) - 1, hist[i]);
+		}
+	}
+}
+
+void printLatency(const char *title, latencyLog *log) {
+	u32int sorted[HEAP_LATENCY_SAMPLES];
+	int count = log->count;
+
+	kprintf("\n%s\n=======================\n", title);
+
+	if (count == 0) {
+		serial_println("No samples");
+		return;
+	}
+
+	// Insertion sort a copy, the log keeps being written while we print
+	int i;
+	for (i = 0; i < count; i++) {
+		u32int sample = log->samples[i];
+		int j = i;
+		while (j > 0 && sorted[j - 1] > sample) {
+			sorted[j] = sorted[j - 1];
+			j--;
+		}
+		sorted[j] = sample;
+	}
+
+	printStat("Samples: ", count);
+	printCycles("p50: ", sorted[count * 50 / 100]);
+	printCycles("p90: ", sorted[count * 90 / 100]);
+	printCycles("p99: ", sorted[count * 99 / 100]);
+	printCycles("Max: ", sorted[count - 1]);
+}
+
+/**
+ * Turns the allocation site profiler on or off, or displays the sites that own the most live
+ * memory and the sites that allocate most often. Addresses can be turned into function names
+ * on the host with tools/symbolize.sh.
+ *
+ * Usage: heapProfile [--on] [--off]
+ *
+ * Args:
+ *	[no args] - Displays the profile
+ *	--on - Clears the profile and starts recording allocations
+ *	--off - Stops recording allocations
+ *
+ * @param args The arguments to pass to the function
+ * @param numArgs The number of arguments
+ * @return A status message indicating success/failure
+ */
+const char *heapProfile(char **args, int numArgs) {
+	if (numArgs == 1 && strcmp(args[0], "--on") == 0) {
+		setProfiling(true);
+		return "Profiling on";
+	} else if (numArgs == 1 && strcmp(args[0], "--off") == 0) {
+		setProfiling(false);
+		return "Profiling off";
+	} else if (numArgs != 0) {
+		return HELP_R5_COMMAND_HEAPPROFILE;
+	}
+
+	kprintf("\nHeap Profile\n=======================\n");
+	serial_print("Profiling: ");
+	serial_println(isProfiling() ? "on" : "off");
+	printCycles("Cycles Profiled: ", getProfileCycles());
+	printStat("Allocations Dropped: ", getProfileDropped());
+
+	printTopSites("Top Sites By Live Bytes", true);
+	printTopSites("Top Sites By Allocations", false);
+
+	return "";
+}
+
+void printTopSites(const char *title, boolean byBytes) {
+	int count;
+	allocSite *sites = getProfileSites(&count);
+	boolean shown[PROFILE_SITES];
+
+	kprintf("\n%s\n=======================\n", title);
+
+	int i;
+	for (i = 0; i < count; i++) {
+		shown[i] = false;
+	}
+
+	// Selection of the top few, the site table is small
+	int rank;
+	for (rank = 0; rank < PROFILE_TOP && rank < count; rank++) {
+		int best = -1;
+		for (i = 0; i < count; i++) {
+			if (shown[i]) {
+				continue;
+			}
+			int value = byBytes ? sites[i].liveBytes : sites[i].allocations;
+			int bestValue = best < 0 ? -1 : (byBytes ? sites[best].liveBytes : sites[best].allocations);
+			if (value > bestValue) {
+				best = i;
+			}
+		}
+		shown[best] = true;
+
+		printSiteInfo(&sites[best]);
+		serial_print("\n");
+	}
+}
+
+void printSiteInfo(allocSite *site) {
+	profileRecord *records = getProfileRecords();
+	u32int now = rdtsc();
+	u32int oldest = 0;
+
+	// Age of the oldest live block, a site whose blocks only get older is likely leaking
+	int i;
+	for (i = 0; i < PROFILE_BLOCKS; i++) {
+		if (records[i].block != NULL && records[i].site == site) {
+			u32int age = (now - records[i].time) & 0xFFFFFFFF;
+			if (age > oldest) {
+				oldest = age;
+			}
+		}
+	}
+
+	printAddress("Caller: ", site->caller);
+	printAddress("Caller's Caller: ", site->callerParent);
+	printStat("Live Bytes: ", site->liveBytes);
+	printStat("Live Blocks: ", site->liveBlocks);
+	printStat("Allocations: ", site->allocations);
+	printCycles("Oldest Block Age (cycles): ", oldest);
+}
+
+void printAddress(const char *label, void *addr) {
+	kprintf("%s0x%x\n", label, (u32int)addr);
+}
+
+/**
+ * Turns allocation tracing on or off. While on, every allocation and free is written to the
+ * terminal as a record that tools/heapbench/heapreplay can replay on the host.
+ *
+ * Usage: heapTrace --on|--off|--port n
+ *
+ * Args:
+ *	--on - Starts writing a record for every allocation and free
+ *	--off - Stops writing records
+ *	--port n - Writes the records to COMn or virtio, or to the terminal for 0; not the port carrying
+ *		the event trace
+ *
+ * @param args The arguments to pass to the function
+ * @param numArgs The number of arguments
+ * @return A status message indicating success/failure
+ */
+const char *heapTrace(char **args, int numArgs) {
+	if (numArgs == 2 && strcmp(args[0], "--port") == 0) {
+		int device = serial_lookup(args[1]);
+		if (device == 0) {
+			setTraceDevice(0);
+			return "Tracing to the terminal";
+		}
+		if (device < 0) {
+			return "No such serial port";
+		}
+		if (device == ktrace_get_device() && ktraceMask != 0) {
+			return "That port carries the event trace";
+		}
+		setTraceDevice(device);
+		return "Tracing port set";
+	} else if (numArgs == 1 && strcmp(args[0], "--on") == 0) {
+		setTracing(true);
+		return "Tracing on";
+	} else if (numArgs == 1 && strcmp(args[0], "--off") == 0) {
+		setTracing(false);
+		return "Tracing off";
+	}
+	return HELP_R5_COMMAND_HEAPTRACE;
+}
+
+/**
+ * Displays the heap guard counters and the last corruption found, sets how often allocations
+ * are guarded, or checks the whole heap now.
+ *
+ * Usage: heapGuard [--rate n] [--check]
+ *
+ * Args:
+ *	[no args] - Displays the guard counters
+ *	--rate n - Guards one in every n allocations, 0 turns guard mode off
+ *	--check - Checks every block in the heap
+ *
+ * @param args The arguments to pass to the function
+ * @param numArgs The number of arguments
+ * @return A status message indicating success/failure
+ */
+const char *heapGuard(char **args, int numArgs) {
+	if (numArgs == 2 && strcmp(args[0], "--rate") == 0) {
+		int rate = atoi(args[1]);
+		if (rate < 0) {
+			return HELP_INVALID_ARGUMENTS;
+		}
+		setHeapGuard(rate);
+		return rate == 0 ? "Guard mode off" : "Guard rate set";
+	} else if (numArgs == 1 && strcmp(args[0], "--check") == 0) {
+		int errors = heapGuardSweep(0);
+		return errors == 0 ? "Heap OK" : "Heap corruption found, see heapGuard";
+	} else if (numArgs != 0) {
+		return HELP_R5_COMMAND_HEAPGUARD;
+	}
+
+	guardReport report;
+	getGuardReport(&report);
+
+	kprintf("\nHeap Guard\n=======================\n");
+	printStat("Rate (1 in): ", report.rate);
+	printStat("Guarded Allocations: ", report.guarded);
+	printStat("Quarantined Blocks: ", report.quarantined);
+	printStat("Full Sweeps: ", report.sweeps);
+	printStat("Errors: ", report.errors);
+
+	if (report.errors > 0) {
+		static const char *kinds[] = {"", "Corrupted header", "Canary overwritten",
+				"Freed memory written", "Freed twice"};
+
+		serial_print("Last Error: ");
+		serial_println(kinds[report.lastKind]);
+		printAddress("Block: ", report.lastBlock);
+		serial_print("Process Name: ");
+		serial_println(report.lastName);
+	}
+	return "";
 }
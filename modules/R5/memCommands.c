@@ -4,6 +4,7 @@
 
 #include <mem/memoryControl.h>
 #include <boolean.h>
+#include <printf.h>
 #include <core/comHandler.h>
 #include <core/help.h>
 #include <modules/mpx_supt.h>
@@ -50,7 +51,7 @@ const char *allocateMem(char **args, int numArgs){
 	}
     int memAddress = (int)allocateMemory(atoi(args[0]));
     char* endString = sys_alloc_mem(50);
-    itoa(memAddress, endString, 10);
+    ksnprintf(endString, 50, "%d", memAddress);
     return endString;
 }
 
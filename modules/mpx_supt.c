@@ -1,7 +1,12 @@
 #include <modules/mpx_supt.h>
 #include <mem/heap.h>
+#include <mem/memoryControl.h>
+#include <mem/stack.h>
 #include <core/queue.h>
 #include <core/pcb.h>
+#include <core/serial.h>
+#include <core/klog.h>
+#include <core/ktrace.h>
 
 param params;
 int current_module = -1;
@@ -9,6 +14,8 @@ void *(*student_malloc)(int);
 
 pcb* cop = NULL;
 context* callerContext;
+pcb* serialReader = NULL; //process blocked in READ until input arrives
+u32int exitedStack = 0; //stack of the last process to exit, freed once off it
 
 boolean (*student_free)(void *);
 
@@ -19,6 +26,15 @@ boolean (*student_free)(void *);
  * @return u32int position of stackTop
  */
 u32int* sys_call(context *registers){
+	int from = cop == NULL ? -1 : cop->pid; //cop is gone after an EXIT
+
+	//an exiting process makes its last system call on its own stack, so
+	//that stack is only released by the next one, which runs on another
+	if(exitedStack != 0){
+		free_stack(exitedStack);
+		exitedStack = 0;
+	}
+
 	if(cop == NULL){
 		callerContext = registers;
 	}
@@ -27,17 +43,43 @@ u32int* sys_call(context *registers){
 			cop->stackTop = (unsigned char*)registers;
 			insertPCB(cop);
 		}
+		if(params.op_code == READ){
+			cop->stackTop = (unsigned char*)registers;
+			if(!serial_input_pending()){
+				cop->state = BLOCKED;
+				serialReader = cop;
+			}
+			insertPCB(cop);
+		}
 		if(params.op_code == EXIT){
 			removePCB(cop);
+			freeProcessMemory(cop); //release everything the process allocated
+			exitedStack = (u32int)cop->stackBottom;
+			cop->stackBottom = NULL;
 			freePCB(cop); //doesnt work yet
 		}
 	}
 
+	//the receive interrupt only fills the ring; the reader is moved back here
+	//so the queues are never touched from an interrupt handler
+	if(serialReader != NULL && serial_input_pending()){
+		removePCB(serialReader);
+		serialReader->state = READY;
+		insertPCB(serialReader);
+		serialReader = NULL;
+	}
+
 	if(getReadyQueue() != NULL){
 		cop = popReady();
+		if(ktrace_on(KTRACE_SCHED)){
+			ktrace_sched(from, cop->pid, params.op_code);
+		}
 		return (u32int*)cop->stackTop;
 	}
 	cop = NULL;
+	if(ktrace_on(KTRACE_SCHED)){
+		ktrace_sched(from, -1, params.op_code);
+	}
 
 	return (u32int*)callerContext;
 }
@@ -122,15 +164,31 @@ int sys_free_mem(void *ptr) {
 	if (current_module >= MODULE_R5)
 		//todo do this
 		return (*student_free)(ptr);
-	// otherwise we don't free anything
-	return -1;
+	kfree((u32int) ptr);
+	return 0;
 }
 
 /**
- * The idle process
+ * The idle process. Uses the spare time to print the kernel log, to
+ * refill the heap's pool of pre-zeroed memory and to check the heap for
+ * corruption in guard mode. Halts until the next interrupt when nothing
+ * else can run.
  */
 void idle() {
 	while (1) {
+		klog_drain();
+		ktrace_drain();
+		boolean scrubbed = scrubFreeMemory();
+		heapGuardSweep(GUARD_SWEEP_BLOCKS);
+
+		//sti takes effect after hlt starts, so an interrupt between the
+		//check and the hlt still wakes it
+		cli();
+		if (!scrubbed && getReadyQueue() == NULL && !serial_input_pending() && !klog_pending() && !ktrace_pending()) {
+			asm volatile ("sti; hlt");
+		} else {
+			sti();
+		}
 		sys_req(IDLE);
 	}
 }
@@ -147,3 +205,12 @@ const char * getCOPName(){
 	return cop->processName;
 
 }
+
+/**
+ * Gets the COP
+ *
+ * @return pcb pointer to the COP, or NULL if no process is running
+ */
+pcb *getCOP(){
+	return cop;
+}
@@ -0,0 +1,50 @@
+#ifndef _HEAPBENCH_BENCH_H
+#define _HEAPBENCH_BENCH_H
+
+/*
+ * Interface between the host programs and kernel/mem/memoryControl.c built for the host.
+ * Only plain C types cross it, since the kernel headers and the C library cannot be
+ * included in the same file.
+ *
+ * Trace format, one record per line:
+ *	a <id> <size>	allocate size bytes and remember the block as id
+ *	f <id>		free the block remembered as id
+ * Lines starting with '#' are comments. Records captured from the kernel with the heapTrace
+ * command start with "HT " and are read as is, and any other line is skipped, so a whole
+ * serial log can be replayed.
+ */
+
+/**
+ * Gives the heap an arena to run in and initializes it
+ *
+ * @param arena - page aligned memory of at least benchArenaSize() bytes
+ * @param size - initial heap size in bytes
+ * @return 1 on success, 0 on failure
+ */
+int benchInit(void *arena, int size);
+
+/**
+ * Returns the size of the arena benchInit needs
+ *
+ * @return bytes
+ */
+int benchArenaSize();
+
+void *benchAlloc(int size);
+int benchFree(void *ptr);
+
+/**
+ * Returns the percent of free memory outside the largest free block
+ *
+ * @return fragmentation, 0 to 100
+ */
+int benchFragmentation();
+
+/**
+ * Returns the number of bytes currently mapped for the heap
+ *
+ * @return bytes
+ */
+int benchHeapSize();
+
+#endif
@@ -0,0 +1,176 @@
+/*
+ * Writes synthetic allocation traces for heapreplay. See bench.h for the format.
+ *
+ * Usage: heapgen churn|history|bursty [records] [seed]
+ *
+ *	churn - processes being created and exiting, each with a PCB, name, stack, queue node
+ *		and a few allocations of its own that are all freed when it exits
+ *	history - command handler use: an input buffer and short lived tokens per command,
+ *		with a bounded history of command strings that rolls over
+ *	bursty - bursts of I/O sized buffers allocated together and freed mostly in order,
+ *		with a few outliving their burst
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_PROCS 12
+#define PROC_BLOCKS 32
+#define HISTORY 50
+#define MAX_BURST 64
+#define MAX_LINGER 16
+
+// Internal function prototypes
+long _alloc(int size);
+void _free(long id);
+void _churn();
+void _history();
+void _bursty();
+
+long nextId = 1;
+long records;
+long limit = 100000;
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s churn|history|bursty [records] [seed]\n", argv[0]);
+		return 2;
+	}
+	if (argc > 2) {
+		limit = atol(argv[2]);
+	}
+	srand(argc > 3 ? atoi(argv[3]) : 1);
+
+	printf("# heapgen %s %ld\n", argv[1], limit);
+	if (strcmp(argv[1], "churn") == 0) {
+		_churn();
+	} else if (strcmp(argv[1], "history") == 0) {
+		_history();
+	} else if (strcmp(argv[1], "bursty") == 0) {
+		_bursty();
+	} else {
+		fprintf(stderr, "unknown workload %s\n", argv[1]);
+		return 2;
+	}
+	return 0;
+}
+
+/**
+ * Writes an allocation record
+ *
+ * @param size The size to allocate
+ * @return The id of the new block
+ */
+long _alloc(int size) {
+	printf("a %ld %d\n", nextId, size);
+	records++;
+	return nextId++;
+}
+
+/**
+ * Writes a free record
+ *
+ * @param id The block to free
+ */
+void _free(long id) {
+	printf("f %ld\n", id);
+	records++;
+}
+
+void _churn() {
+	long blocks[MAX_PROCS][PROC_BLOCKS];
+	int counts[MAX_PROCS];
+	int live = 0;
+
+	while (records < limit) {
+		if (live < MAX_PROCS && (live == 0 || rand() % 3 != 0)) {	// Create a process
+			long *b = blocks[live];
+			int n = 0;
+			b[n++] = _alloc(64);		// PCB
+			b[n++] = _alloc(256);		// Name
+			b[n++] = _alloc(4096);		// Stack
+			b[n++] = _alloc(12);		// Queue node
+			int extra = rand() % 8;
+			while (extra-- > 0 && n < PROC_BLOCKS) {
+				b[n++] = _alloc(16 + rand() % 496);
+			}
+			counts[live++] = n;
+		} else {							// A random process exits
+			int p = rand() % live;
+			int i;
+			for (i = counts[p] - 1; i >= 0; i--) {
+				_free(blocks[p][i]);
+			}
+			live--;
+			memcpy(blocks[p], blocks[live], sizeof(blocks[p]));
+			counts[p] = counts[live];
+		}
+	}
+}
+
+void _history() {
+	long history[HISTORY];
+	int head = 0;
+	int count = 0;
+
+	while (records < limit) {
+		long input = _alloc(100);
+		long tokens[6];
+		int n = 1 + rand() % 6;
+		int i;
+		for (i = 0; i < n; i++) {
+			tokens[i] = _alloc(4 + rand() % 29);
+		}
+		if (rand() % 10 == 0) {
+			_free(_alloc(21));			// Date/time string
+		}
+
+		if (count == HISTORY) {			// Oldest command rolls off
+			_free(history[head]);
+			count--;
+		}
+		history[(head + count) % HISTORY] = _alloc(20 + rand() % 61);
+		if (count == HISTORY - 1) {
+			head = (head + 1) % HISTORY;
+		}
+		count++;
+
+		for (i = n - 1; i >= 0; i--) {
+			_free(tokens[i]);
+		}
+		_free(input);
+	}
+}
+
+void _bursty() {
+	static const int sizes[] = {512, 1024, 2048, 4096};
+	long burst[MAX_BURST];
+	long linger[MAX_LINGER];
+	int lingering = 0;
+
+	while (records < limit) {
+		int n = 8 + rand() % (MAX_BURST - 7);
+		int i;
+		for (i = 0; i < n; i++) {
+			if (rand() % 4 == 0) {
+				_alloc(32);				// Header, freed with the burst below
+				burst[i] = nextId - 1;
+			} else {
+				burst[i] = _alloc(sizes[rand() % 4] + rand() % 64);
+			}
+		}
+
+		for (i = 0; i < n; i++) {
+			if (rand() % 20 == 0) {		// Outlives its burst
+				if (lingering == MAX_LINGER) {
+					_free(linger[0]);
+					memmove(linger, linger + 1, sizeof(long) * (MAX_LINGER - 1));
+					lingering--;
+				}
+				linger[lingering++] = burst[i];
+			} else {
+				_free(burst[i]);
+			}
+		}
+	}
+}
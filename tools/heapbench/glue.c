@@ -0,0 +1,132 @@
+/*
+ * Kernel side of the host build. Stands in for the paging and process code memoryControl.c
+ * calls into, and wraps the heap in the interface from bench.h. Built against the kernel
+ * headers with HOST_HEAP defined.
+ */
+#include <system.h>
+#include <boolean.h>
+#include <mem/paging.h>
+#include <mem/memoryControl.h>
+
+#include "bench.h"
+
+void *hostArena;
+page_dir *kdir;
+page_entry hostPages[HEAP_VIRT_SIZE / PAGE_SIZE]; //one entry per page of the arena
+
+page_entry *get_page(u32int addr, page_dir *dir, int make_table){
+	no_warn(dir);
+	no_warn(make_table);
+	u32int base = (u32int)hostArena;
+	if (addr < base || addr >= base + HEAP_VIRT_SIZE){
+		return NULL;
+	}
+	return &hostPages[(addr - base) / PAGE_SIZE];
+}
+
+void new_frame(page_entry *page){
+	page->present = 1;
+	page->writeable = 1;
+}
+
+void free_frame(page_entry *page){
+	page->present = 0;
+	page->writeable = 0;
+}
+
+void invalidate_page(u32int addr){
+	no_warn(addr);
+}
+
+int register_region(u32int start, u32int end, int (*allows)(u32int addr)){
+	no_warn(start);
+	no_warn(end);
+	no_warn(allows);
+	return 1; //the arena is ordinary memory, nothing to fault in
+}
+
+pcb *getCOP(){
+	return NULL; //everything is charged to the kernel account
+}
+
+const char *getCOPName(){
+	return "heapbench";
+}
+
+//tracing is never turned on in the host build
+int serial_print(const char *msg){
+	no_warn(msg);
+	return 0;
+}
+
+int serial_println(const char *msg){
+	no_warn(msg);
+	return 0;
+}
+
+void serial_write_device(int device, const char *buf, int len){
+	no_warn(device);
+	no_warn(buf);
+	no_warn(len);
+}
+
+void klogv(const char *msg){
+	no_warn(msg);
+}
+
+void klog(int subsystem, int level, const char *msg){
+	no_warn(subsystem);
+	no_warn(level);
+	no_warn(msg);
+}
+
+//the binary trace is never turned on either
+u32int ktraceMask = 0;
+
+void ktrace_alloc(u32int addr, u32int size){
+	no_warn(addr);
+	no_warn(size);
+}
+
+void ktrace_free(u32int addr){
+	no_warn(addr);
+}
+
+void itoa(int num, char *str, int base){
+	no_warn(num);
+	no_warn(base);
+	str[0] = '\0';
+}
+
+int benchInit(void *arena, int size){
+	hostArena = arena;
+	return initializeHeap(size);
+}
+
+int benchArenaSize(){
+	return HEAP_VIRT_SIZE;
+}
+
+void *benchAlloc(int size){
+	return allocateMemory(size);
+}
+
+int benchFree(void *ptr){
+	return deallocateMemory(ptr);
+}
+
+int benchFragmentation(){
+	heapStats stats;
+	if (!getHeapStats(&stats)){
+		return 0;
+	}
+	return stats.fragmentation;
+}
+
+int benchHeapSize(){
+	heapStats stats;
+	if (!getHeapStats(&stats)){
+		return 0;
+	}
+	return stats.heapSize;
+}
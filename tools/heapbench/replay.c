@@ -0,0 +1,218 @@
+/*
+ * Replays an allocation trace against memoryControl.c and reports throughput, peak
+ * fragmentation and worst case latency. See bench.h for the trace format.
+ *
+ * Usage: heapreplay [-s sampleEvery] [-i initialHeap] [trace]
+ *
+ * The trace is read from stdin if no file is given. Fragmentation needs a walk of the free
+ * list, so it is only sampled every sampleEvery records (default 1000) and after the last one.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench.h"
+
+typedef struct {
+	long id;
+	void *ptr; //NULL if the slot is empty
+} liveBlock;
+
+// Internal function prototypes
+liveBlock *_findSlot(long id);
+void _growTable();
+long _nowNs();
+
+liveBlock *table;
+long tableSize = 1024; //always a power of two
+long tableUsed;
+
+int main(int argc, char **argv) {
+	long sampleEvery = 1000;
+	int initialHeap = 0x10000;
+	const char *path = NULL;
+	int i;
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+			sampleEvery = atol(argv[++i]);
+		} else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+			initialHeap = atoi(argv[++i]);
+		} else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+			fprintf(stderr, "usage: %s [-s sampleEvery] [-i initialHeap] [trace]\n", argv[0]);
+			return 2;
+		} else {
+			path = argv[i];
+		}
+	}
+	if (sampleEvery <= 0) {
+		sampleEvery = 1;
+	}
+
+	FILE *in = stdin;
+	if (path != NULL && strcmp(path, "-") != 0) {
+		in = fopen(path, "r");
+		if (in == NULL) {
+			perror(path);
+			return 1;
+		}
+	}
+
+	void *arena = aligned_alloc(4096, benchArenaSize());
+	if (arena == NULL || !benchInit(arena, initialHeap)) {
+		fprintf(stderr, "could not initialize the heap\n");
+		return 1;
+	}
+	table = calloc(tableSize, sizeof(liveBlock));
+
+	long allocs = 0, frees = 0, failed = 0, unknown = 0, records = 0;
+	long totalNs = 0, worstAllocNs = 0, worstFreeNs = 0;
+	int peakFrag = 0, peakHeap = 0;
+	char line[256];
+
+	while (fgets(line, sizeof(line), in) != NULL) {
+		char *rec = line;
+		if (strncmp(rec, "HT ", 3) == 0) {	// Captured from the kernel
+			rec += 3;
+		}
+
+		char op;
+		long id;
+		int size;
+		int fields = sscanf(rec, " %c %ld %d", &op, &id, &size);
+
+		if (fields == 3 && op == 'a') {
+			long start = _nowNs();
+			void *ptr = benchAlloc(size);
+			long took = _nowNs() - start;
+
+			totalNs += took;
+			if (took > worstAllocNs) {
+				worstAllocNs = took;
+			}
+			allocs++;
+			if (ptr == NULL) {
+				failed++;
+			} else {
+				if ((tableUsed + 1) * 2 > tableSize) {
+					_growTable();
+				}
+				liveBlock *slot = _findSlot(id);
+				if (slot->ptr != NULL) {	// Id reused without a free, drop the old block
+					benchFree(slot->ptr);
+				} else {
+					tableUsed++;
+				}
+				slot->id = id;
+				slot->ptr = ptr;
+			}
+		} else if (fields >= 2 && op == 'f') {
+			liveBlock *slot = _findSlot(id);
+			frees++;
+			if (slot->ptr == NULL) {
+				unknown++;
+				continue;
+			}
+
+			long start = _nowNs();
+			benchFree(slot->ptr);
+			long took = _nowNs() - start;
+
+			totalNs += took;
+			if (took > worstFreeNs) {
+				worstFreeNs = took;
+			}
+
+			// Remove the slot and re-place the rest of its probe run
+			slot->ptr = NULL;
+			tableUsed--;
+			long j = (slot - table + 1) & (tableSize - 1);
+			while (table[j].ptr != NULL) {
+				liveBlock moved = table[j];
+				table[j].ptr = NULL;
+				*_findSlot(moved.id) = moved;
+				j = (j + 1) & (tableSize - 1);
+			}
+		} else {
+			continue;		// Comment or console output
+		}
+
+		if (++records % sampleEvery == 0) {
+			int frag = benchFragmentation();
+			int heap = benchHeapSize();
+			if (frag > peakFrag) {
+				peakFrag = frag;
+			}
+			if (heap > peakHeap) {
+				peakHeap = heap;
+			}
+		}
+	}
+
+	int frag = benchFragmentation();
+	int heap = benchHeapSize();
+	if (frag > peakFrag) {
+		peakFrag = frag;
+	}
+	if (heap > peakHeap) {
+		peakHeap = heap;
+	}
+
+	long ops = allocs + frees - unknown;
+	printf("records:            %ld\n", records);
+	printf("allocations:        %ld (%ld failed)\n", allocs, failed);
+	printf("frees:              %ld (%ld of unknown ids)\n", frees, unknown);
+	printf("heap time:          %.3f ms\n", totalNs / 1e6);
+	printf("throughput:         %.0f ops/s\n", totalNs > 0 ? ops * 1e9 / totalNs : 0.0);
+	printf("mean op latency:    %.0f ns\n", ops > 0 ? (double)totalNs / ops : 0.0);
+	printf("worst alloc:        %ld ns\n", worstAllocNs);
+	printf("worst free:         %ld ns\n", worstFreeNs);
+	printf("peak fragmentation: %d%%\n", peakFrag);
+	printf("peak heap size:     %d bytes\n", peakHeap);
+	printf("live at end:        %ld blocks\n", tableUsed);
+	return 0;
+}
+
+/**
+ * Finds the slot an id is in, or the empty slot it would go in
+ *
+ * @param id The block id
+ * @return Pointer to the slot
+ */
+liveBlock *_findSlot(long id) {
+	unsigned long hash = (unsigned long)id * 0x9E3779B97F4A7C15ul;
+	long i = (long)(hash >> 20) & (tableSize - 1);
+	while (table[i].ptr != NULL && table[i].id != id) {
+		i = (i + 1) & (tableSize - 1);
+	}
+	return &table[i];
+}
+
+/**
+ * Doubles the id table
+ */
+void _growTable() {
+	liveBlock *old = table;
+	long oldSize = tableSize;
+
+	tableSize *= 2;
+	table = calloc(tableSize, sizeof(liveBlock));
+	long i;
+	for (i = 0; i < oldSize; i++) {
+		if (old[i].ptr != NULL) {
+			*_findSlot(old[i].id) = old[i];
+		}
+	}
+	free(old);
+}
+
+/**
+ * Reads the monotonic clock
+ *
+ * @return Nanoseconds
+ */
+long _nowNs() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
@@ -0,0 +1,218 @@
+/*
+ * Decodes a binary event trace captured from the kernel's ktrace port into CSV or JSON.
+ * See include/core/ktrace.h for the frame layout.
+ *
+ * Usage: ktracedump [-j] [trace]
+ *
+ * The trace is read from stdin if no file is given, so a live port can be piped in. Output
+ * is CSV with one row per event, or one JSON object per line with -j. Bytes that are not
+ * part of a frame with a good CRC are skipped, and the count is reported on stderr.
+ *
+ * CSV columns: tsc,us,event,from,to,op,addr,size,irq,lost
+ * us is the time since the first event, known once a clock frame has been seen.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#define SYNC        0xA5
+#define HEADER      11
+#define MAX_PAYLOAD 16
+#define MAX_FRAME   (HEADER + MAX_PAYLOAD + 2)
+
+#define EV_CLOCK 1
+#define EV_SCHED 2
+#define EV_ALLOC 3
+#define EV_FREE  4
+#define EV_IRQ   5
+#define EV_LOST  6
+
+// Internal function prototypes
+uint16_t _crc16(const uint8_t *data, int len);
+uint32_t _u32(const uint8_t *p);
+void _printEvent(const uint8_t *frame, int json);
+
+static const char *eventNames[] = {"?", "clock", "sched", "alloc", "free", "irq", "lost"};
+
+uint64_t firstTsc;
+int haveFirst = 0;
+uint32_t tscPerMs = 0; //0 until a clock frame is seen
+
+int main(int argc, char **argv) {
+	const char *path = NULL;
+	int json = 0;
+	int i;
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-j") == 0) {
+			json = 1;
+		} else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+			fprintf(stderr, "usage: %s [-j] [trace]\n", argv[0]);
+			return 2;
+		} else {
+			path = argv[i];
+		}
+	}
+
+	FILE *in = stdin;
+	if (path != NULL && strcmp(path, "-") != 0) {
+		in = fopen(path, "rb");
+		if (in == NULL) {
+			perror(path);
+			return 1;
+		}
+	}
+
+	if (!json) {
+		printf("tsc,us,event,from,to,op,addr,size,irq,lost\n");
+	}
+
+	uint8_t buf[MAX_FRAME];
+	int have = 0, c;
+	long frames = 0, skipped = 0;
+
+	for (;;) {
+		// Fill to a whole header, then to a whole frame
+		int need = have < HEADER ? HEADER : HEADER + buf[2] + 2;
+		if (have >= 1 && buf[0] != SYNC) {
+			need = 0;
+		} else if (have >= HEADER && buf[2] > MAX_PAYLOAD) {
+			need = 0;
+		}
+
+		if (need > have) {
+			if ((c = getc(in)) == EOF) {
+				break;
+			}
+			buf[have++] = c;
+			continue;
+		}
+
+		if (need != 0) {
+			int len = buf[2];
+			uint16_t crc = buf[HEADER + len] | buf[HEADER + len + 1] << 8;
+			if (crc == _crc16(buf + 1, HEADER - 1 + len)) {
+				_printEvent(buf, json);
+				frames++;
+				have = 0;
+				continue;
+			}
+		}
+
+		// Not a frame: drop a byte and look for the next sync
+		memmove(buf, buf + 1, --have);
+		skipped++;
+	}
+	skipped += have;
+
+	fprintf(stderr, "%ld events, %ld bytes skipped\n", frames, skipped);
+	if (in != stdin) {
+		fclose(in);
+	}
+	return 0;
+}
+
+/**
+ * Computes the CRC-16/CCITT the kernel puts at the end of a frame
+ *
+ * @param data - the bytes after the sync byte
+ * @param len - the number of bytes
+ * @return the CRC
+ */
+uint16_t _crc16(const uint8_t *data, int len) {
+	uint16_t crc = 0xFFFF;
+	int i, b;
+	for (i = 0; i < len; i++) {
+		crc ^= data[i] << 8;
+		for (b = 0; b < 8; b++) {
+			crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+		}
+	}
+	return crc;
+}
+
+/**
+ * Reads a little-endian 32 bit value
+ *
+ * @param p - the first byte
+ * @return the value
+ */
+uint32_t _u32(const uint8_t *p) {
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/**
+ * Writes one event as a CSV row or a JSON object
+ *
+ * @param frame - a frame with a good CRC
+ * @param json - 1 for JSON
+ */
+void _printEvent(const uint8_t *frame, int json) {
+	int type = frame[1];
+	const uint8_t *p = frame + HEADER;
+	uint64_t tsc = _u32(frame + 3) | (uint64_t)_u32(frame + 7) << 32;
+	char us[24] = "", fields[96] = "";
+	long long from = 0, to = 0;
+
+	if (!haveFirst) {
+		firstTsc = tsc;
+		haveFirst = 1;
+	}
+	if (type == EV_CLOCK && frame[2] >= 4) {
+		tscPerMs = _u32(p);
+	}
+	if (tscPerMs != 0) {
+		snprintf(us, sizeof(us), "%.3f", (double)(tsc - firstTsc) * 1000.0 / tscPerMs);
+	}
+	if (type == EV_SCHED && frame[2] >= 9) {
+		from = (int32_t)_u32(p);
+		to = (int32_t)_u32(p + 4);
+	}
+
+	if (json) {
+		switch (type) {
+			case EV_CLOCK:
+				snprintf(fields, sizeof(fields), ",\"tscPerMs\":%u", tscPerMs);
+				break;
+			case EV_SCHED:
+				snprintf(fields, sizeof(fields), ",\"from\":%lld,\"to\":%lld,\"op\":%u", from, to, p[8]);
+				break;
+			case EV_ALLOC:
+				snprintf(fields, sizeof(fields), ",\"addr\":\"0x%x\",\"size\":%u", _u32(p), _u32(p + 4));
+				break;
+			case EV_FREE:
+				snprintf(fields, sizeof(fields), ",\"addr\":\"0x%x\"", _u32(p));
+				break;
+			case EV_IRQ:
+				snprintf(fields, sizeof(fields), ",\"irq\":%u", p[0]);
+				break;
+			case EV_LOST:
+				snprintf(fields, sizeof(fields), ",\"lost\":%u", _u32(p));
+				break;
+		}
+		printf("{\"tsc\":%llu,\"us\":%s,\"event\":\"%s\"%s}\n", (unsigned long long)tsc,
+				us[0] != '\0' ? us : "null", type <= EV_LOST ? eventNames[type] : "?", fields);
+		return;
+	}
+
+	switch (type) {
+		case EV_SCHED:
+			snprintf(fields, sizeof(fields), "%lld,%lld,%u,,,,", from, to, p[8]);
+			break;
+		case EV_ALLOC:
+			snprintf(fields, sizeof(fields), ",,,0x%x,%u,,", _u32(p), _u32(p + 4));
+			break;
+		case EV_FREE:
+			snprintf(fields, sizeof(fields), ",,,0x%x,,,", _u32(p));
+			break;
+		case EV_IRQ:
+			snprintf(fields, sizeof(fields), ",,,,,%u,", p[0]);
+			break;
+		case EV_LOST:
+			snprintf(fields, sizeof(fields), ",,,,,,%u", _u32(p));
+			break;
+		default:
+			snprintf(fields, sizeof(fields), ",,,,,,");
+			break;
+	}
+	printf("%llu,%s,%s,%s\n", (unsigned long long)tsc, us, type <= EV_LOST ? eventNames[type] : "?", fields);
+}
@@ -0,0 +1,36 @@
+#!/bin/sh
+#
+# Turns the addresses in heapProfile output into function names and source lines.
+#
+# Usage: tools/symbolize.sh [kernel.bin] < profile.txt
+#
+# Each line gets "function (file:line)" appended for every nonzero 0x... address on it, in
+# order. Set ADDR2LINE to pick the addr2line to use, it defaults to the cross toolchain's.
+
+KERNEL=${1:-kernel.bin}
+ADDR2LINE=${ADDR2LINE:-i386-elf-addr2line}
+
+if ! command -v "$ADDR2LINE" > /dev/null 2>&1; then
+	ADDR2LINE=addr2line
+fi
+if [ ! -f "$KERNEL" ]; then
+	echo "symbolize: $KERNEL not found" >&2
+	exit 1
+fi
+
+tr -d '\r' | while IFS= read -r line; do
+	out="$line"
+	for addr in $(echo "$line" | grep -o '0x[0-9a-fA-F]\+'); do
+		if [ "$addr" = "0x0" ]; then
+			continue
+		fi
+
+		# Return addresses point after the call, step back one byte to land on it
+		call=$(printf '0x%x' $((addr - 1)))
+		sym=$("$ADDR2LINE" -f -s -e "$KERNEL" "$call" | tr '\n' ' ' | sed 's/ *$//')
+		func=${sym%% *}
+		loc=${sym#* }
+		out="$out $func ($loc)"
+	done
+	echo "$out"
+done